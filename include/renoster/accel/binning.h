@@ -1,12 +1,60 @@
 #ifndef RENOSTER_ACCEL_BINNING_H_
 #define RENOSTER_ACCEL_BINNING_H_
 
+#include <algorithm>
 #include <cstdlib>
+#include <vector>
 
+#include "renoster/bounds.h"
 #include "renoster/mathutil.h"
+#include "renoster/parallel.h"
 
 namespace renoster {
 
+/// Nodes with more primitives than this are binned, partitioned and built
+/// in parallel. Work is split into chunks of this size.
+constexpr size_t ParallelBuildThreshold = 4096;
+
+/// Computes the bounds and centroid bounds of a build record. Chunks are
+/// reduced in parallel for large records.
+template <typename BuildRecord>
+void ComputeRecordBounds(BuildRecord & rec)
+{
+    using PrimInfo = typename BuildRecord::PrimInfo;
+
+    rec.bounds = Bounds3f();
+    rec.centBounds = Bounds3f();
+
+    size_t numPrims = rec.primInfo.size();
+    if (numPrims <= ParallelBuildThreshold) {
+        for (const PrimInfo & info : rec.primInfo) {
+            rec.bounds.ExpandBy(info.bounds);
+            rec.centBounds.ExpandBy(info.centroid);
+        }
+        return;
+    }
+
+    size_t numChunks = (numPrims + ParallelBuildThreshold - 1)
+                       / ParallelBuildThreshold;
+    std::vector<Bounds3f> bounds(numChunks);
+    std::vector<Bounds3f> centBounds(numChunks);
+    ParallelFor(0, numChunks, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t c = begin; c < end; ++c) {
+            size_t first = c * ParallelBuildThreshold;
+            size_t last = std::min(numPrims, first + ParallelBuildThreshold);
+            for (size_t i = first; i < last; ++i) {
+                bounds[c].ExpandBy(rec.primInfo[i].bounds);
+                centBounds[c].ExpandBy(rec.primInfo[i].centroid);
+            }
+        }
+    });
+
+    for (size_t c = 0; c < numChunks; ++c) {
+        rec.bounds.ExpandBy(bounds[c]);
+        rec.centBounds.ExpandBy(centBounds[c]);
+    }
+}
+
 class BinMapping {
 public:
     static constexpr int NumBins = 16;
@@ -49,28 +97,64 @@ class BinInfo {
 public:
     static constexpr int NumBins = BinMapping::NumBins;
 
-    template <typename BuildRecord>
-    BinInfo(const BuildRecord & cur)
-            : mapping_(cur.centBounds) {
-
-        using PrimInfo = typename BuildRecord::PrimInfo;
-
+    BinInfo(const BinMapping & mapping)
+            : mapping_(mapping) {
         for (size_t b = 0; b < NumBins; ++b) {
             for (size_t d = 0; d < 3; ++d) {
                 bounds_[b][d] = Bounds3f();
                 counts_[b][d] = 0;
             }
         }
+    }
+
+    template <typename BuildRecord>
+    BinInfo(const BuildRecord & cur)
+            : BinInfo(BinMapping(cur.centBounds)) {
+        size_t numPrims = cur.primInfo.size();
+        if (numPrims <= ParallelBuildThreshold) {
+            Bin(cur.primInfo.begin(), cur.primInfo.end());
+            return;
+        }
+
+        // Bin chunks in parallel, merging gives the same bins
+        size_t numChunks = (numPrims + ParallelBuildThreshold - 1)
+                           / ParallelBuildThreshold;
+        std::vector<BinInfo> chunks(numChunks, BinInfo(mapping_));
+        ParallelFor(0, numChunks, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t c = begin; c < end; ++c) {
+                size_t first = c * ParallelBuildThreshold;
+                size_t last = std::min(numPrims,
+                                       first + ParallelBuildThreshold);
+                chunks[c].Bin(cur.primInfo.begin() + first,
+                              cur.primInfo.begin() + last);
+            }
+        });
+
+        for (const BinInfo & chunk : chunks) {
+            Merge(chunk);
+        }
+    }
 
-        for (const PrimInfo & info : cur.primInfo) {
-            Point3i bin = mapping_.Bin(info.centroid);
+    template <typename PrimInfo>
+    void Bin(const PrimInfo * begin, const PrimInfo * end) {
+        for (const PrimInfo * info = begin; info != end; ++info) {
+            Point3i bin = mapping_.Bin(info->centroid);
             for (size_t d = 0; d < 3; ++d) {
-                bounds_[bin[d]][d].ExpandBy(info.centroid);
+                bounds_[bin[d]][d].ExpandBy(info->centroid);
                 counts_[bin[d]][d] += 1;
             }
         }
     }
 
+    void Merge(const BinInfo & other) {
+        for (size_t b = 0; b < NumBins; ++b) {
+            for (size_t d = 0; d < 3; ++d) {
+                bounds_[b][d].ExpandBy(other.bounds_[b][d]);
+                counts_[b][d] += other.counts_[b][d];
+            }
+        }
+    }
+
     BinSplit BestSplit() {
         size_t rightCounts[3][BinInfo::NumBins]{};
 
@@ -1,15 +1,24 @@
 #ifndef RENOSTER_ACCEL_BUILDER_H_
 #define RENOSTER_ACCEL_BUILDER_H_
 
+#include <mutex>
+#include <vector>
+
+#include "renoster/accel/binning.h"
 #include "renoster/bounds.h"
 #include "renoster/bvh.h"
 #include "renoster/mathutil.h"
+#include "renoster/parallel.h"
+#include "renoster/stats.h"
 #include "renoster/util/span.h"
 
 namespace renoster {
 
+/// Builds a BVH over pointers to Primitive. Leaf is the type of the leaf
+/// nodes, it can store the primitives in a different format.
 template <typename Primitive,
-          typename Splitter>
+          typename Splitter,
+          typename Leaf = BVH::LeafNode<Primitive>>
 class BVHBuilder {
 public:
     using Split = typename Splitter::Split;
@@ -28,56 +37,61 @@ public:
         span<PrimInfo> primInfo;
     };
 
-    BVHBuilder(BVH * bvh, const Splitter & splitter, size_t minLeafSize)
+    /// Builds nodes with width (4 or 8) children. Only use 8 when
+    /// BVH::NativeWidth() allows it.
+    BVHBuilder(BVH * bvh, const Splitter & splitter, size_t minLeafSize,
+               size_t width = 4)
         : _bvh(bvh),
         _splitter(splitter),
-        _minLeafSize(minLeafSize) {}
+        _minLeafSize(minLeafSize),
+        _width(width) {}
 
     template <typename PrimitiveContext>
     void Build(const PrimitiveContext & ctx, const span<Primitive *> & prims) {
         // Create PrimInfo
         std::vector<PrimInfo> primInfo(prims.size());
-        for (size_t i = 0; i < prims.size(); ++i) {
-            primInfo[i].bounds = prims[i]->GetWorldBounds(ctx);
-            primInfo[i].centroid = primInfo[i].bounds.Center();
-            primInfo[i].prim = prims[i];
-        }
+        ParallelFor(0, prims.size(), ParallelBuildThreshold,
+                    [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+                primInfo[i].bounds = prims[i]->GetWorldBounds(ctx);
+                primInfo[i].centroid = primInfo[i].bounds.Center();
+                primInfo[i].prim = prims[i];
+            }
+        });
 
         // Create initial BuildRecord
         BuildRecord bRec;
-        for (size_t i = 0; i < prims.size(); ++i) {
-            bRec.bounds.ExpandBy(primInfo[i].bounds);
-            bRec.centBounds.ExpandBy(primInfo[i].bounds.Center());
-        }
         bRec.primInfo = span<PrimInfo>(primInfo);
+        ComputeRecordBounds(bRec);
 
         _bvh->_root = BuildRecursive(bRec);
     }
 
     BVH::NodeRef BuildRecursive(const BuildRecord & cur) {
         // Build a leaf
-        if (cur.primInfo.size() <= _minLeafSize) {
+        if (static_cast<size_t>(cur.primInfo.size()) <= _minLeafSize) {
             return CreateLeaf(cur);
         }
 
-        // Split into 4 children
-        BuildRecord children[4];
+        // Split into as many children as the node can hold
+        BuildRecord children[8];
         children[0] = cur;
         size_t numChildren = 1;
 
-        while (numChildren < 4) {
+        while (numChildren < _width) {
             // Find the child to split
             float worstArea = -Infinity;
-            size_t worstChild = -1;
+            int worstChild = -1;
             for (size_t i = 0; i < numChildren; ++i) {
-                if (children[i].primInfo.size() <= _minLeafSize) {
+                if (static_cast<size_t>(children[i].primInfo.size()) <=
+                        _minLeafSize) {
                     continue;
                 }
 
                 float childArea = children[i].bounds.SurfaceArea();
                 if (childArea > worstArea) {
                     worstArea = childArea;
-                    worstChild = i;
+                    worstChild = static_cast<int>(i);
                 }
             }
 
@@ -102,19 +116,39 @@ public:
         }
 
         // Create the new node
-        BVH::NodeRef nodeRef = CreateNode(children);
-        BVH::BaseNode * node = nodeRef.GetBaseNode();
+        BVH::NodeRef nodeRef;
+        BVH::NodeRef * nodeChildren;
+        if (_width == 8) {
+            nodeRef = CreateNode8(children);
+            nodeChildren = nodeRef.GetWideNode()->children;
+        } else {
+            nodeRef = CreateNode(children);
+            nodeChildren = nodeRef.GetBaseNode()->children;
+        }
 
-        // Recurse
+        // Recurse, large children are built in parallel
+        TaskGroup group;
         for (size_t i = 0; i < numChildren; ++i) {
-            node->children[i] = BuildRecursive(children[i]);
+            if (static_cast<size_t>(children[i].primInfo.size()) >
+                    ParallelBuildThreshold) {
+                group.Spawn([this, nodeChildren, &children, i]() {
+                    nodeChildren[i] = BuildRecursive(children[i]);
+                });
+            } else {
+                nodeChildren[i] = BuildRecursive(children[i]);
+            }
         }
+        group.Wait();
 
         return nodeRef;
     }
 
     BVH::NodeRef CreateNode(BuildRecord children[4]) {
-        BVH::AlignedNode * node = _bvh->_alloc.New<BVH::AlignedNode>();
+        BVH::AlignedNode * node;
+        {
+            std::lock_guard<std::mutex> lock(_allocMutex);
+            node = _bvh->_alloc.New<BVH::AlignedNode>();
+        }
         for (size_t i = 0; i < 4; ++i) {
             for (size_t d = 0; d < 3; ++d) {
                 node->bounds.min()[d][i] = children[i].bounds.min()[d];
@@ -124,22 +158,49 @@ public:
         return BVH::NodeRef(node);
     }
 
+    BVH::NodeRef CreateNode8(BuildRecord children[8]) {
+        BVH::AlignedNode8 * node;
+        {
+            std::lock_guard<std::mutex> lock(_allocMutex);
+            node = _bvh->_alloc.New<BVH::AlignedNode8>();
+        }
+        for (size_t i = 0; i < 8; ++i) {
+            for (size_t d = 0; d < 3; ++d) {
+                node->lower[d][i] = children[i].bounds.min()[d];
+                node->upper[d][i] = children[i].bounds.max()[d];
+            }
+        }
+        return BVH::NodeRef(node);
+    }
+
     BVH::NodeRef CreateLeaf(const BuildRecord & rec) {
-        BVH::LeafNode<Primitive> * leaf =
-            _bvh->_alloc.New<BVH::LeafNode<Primitive>>();
-        leaf->numPrimitives = rec.primInfo.size();
-        leaf->primitives = static_cast<Primitive **>(
-            _bvh->_alloc.Alloc(sizeof(Primitive *) * leaf->numPrimitives));
-        for (size_t i = 0; i < leaf->numPrimitives; ++i) {
-            leaf->primitives[i] = rec.primInfo[i].prim;
+        size_t numPrimitives = rec.primInfo.size();
+        std::vector<Primitive *> prims(numPrimitives);
+        for (size_t i = 0; i < numPrimitives; ++i) {
+            prims[i] = rec.primInfo[i].prim;
         }
-        return BVH::NodeRef(leaf);
+
+        RENO_STAT_ADD(Stat::kLeaves, 1);
+        RENO_STAT_ADD(Stat::kLeafPrimitives, numPrimitives);
+        RENO_STAT_MAX(Stat::kMaxLeafSize, numPrimitives);
+
+        void * bytes;
+        {
+            std::lock_guard<std::mutex> lock(_allocMutex);
+            bytes = _bvh->_leafAlloc.Alloc(Leaf::GetSize(numPrimitives),
+                                           alignof(Leaf));
+        }
+        return BVH::NodeRef(Leaf::Create(bytes, prims.data(), numPrimitives));
     }
 
 private:
     BVH * _bvh;
     const Splitter & _splitter;
     size_t _minLeafSize;
+    size_t _width;
+
+    /// The BVH allocator is shared by all build tasks
+    std::mutex _allocMutex;
 };
 
 } // namespace renoster
@@ -2,8 +2,15 @@
 #define RENOSTER_ACCEL_SPLITTER_H_
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include "renoster/accel/binning.h"
+#include "renoster/bounds.h"
+#include "renoster/parallel.h"
+#include "renoster/util/allocator.h"
 
 namespace renoster {
 
@@ -27,26 +34,258 @@ public:
         using PrimInfo = typename BuildRecord::PrimInfo;
 
         //
-        auto mid = std::partition(cur.primInfo.begin(), cur.primInfo.end(),
-                                  [&split](const PrimInfo & info) {
+        PrimInfo * mid = ParallelPartition(
+                cur.primInfo.begin(), cur.primInfo.end(),
+                [&split](const PrimInfo & info) {
             int bin = split.mapping.Bin(info.centroid)[split.dim];
-            return bin <= split.pos;
-        });
+            return static_cast<size_t>(bin) <= split.pos;
+        }, ParallelBuildThreshold);
 
         //
         left.primInfo = span<PrimInfo>(cur.primInfo.begin(), mid);
-        for (const PrimInfo & info : left.primInfo) {
-            left.bounds.ExpandBy(info.bounds);
-            left.centBounds.ExpandBy(info.centroid);
-        }
+        ComputeRecordBounds(left);
 
         //
         right.primInfo = span<PrimInfo>(mid, cur.primInfo.end());
-        for (const PrimInfo & info : right.primInfo) {
-            right.bounds.ExpandBy(info.bounds);
-            right.centBounds.ExpandBy(info.centroid);
+        ComputeRecordBounds(right);
+    }
+};
+
+struct SpatialSplit {
+    SpatialSplit(const BinSplit & objectSplit)
+        : objectSplit(objectSplit) {}
+
+    /// Bin of a coordinate along the split dimension
+    int Bin(float x) const {
+        int bin = std::floor((x - offset) * scale);
+        return std::max(0, std::min(bin, NumBins - 1));
+    }
+
+    static constexpr int NumBins = BinMapping::NumBins;
+
+    BinSplit objectSplit;
+    bool spatial = false;
+    size_t dim = -1;
+    int plane = -1;
+    float pos = 0.f;
+    float offset = 0.f;
+    float scale = 0.f;
+};
+
+/// SpatialSplitter implements the split search of the SBVH. Next to the
+/// object split it considers splitting the references at a plane, which
+/// duplicates the primitives that straddle it. Spatial splits are only
+/// evaluated when the children of the object split overlap by more than
+/// alpha times the surface area of the root.
+///
+/// Primitives need to implement SplitBounds(ctx, bounds, dim, pos, left,
+/// right), which clips the part of the primitive inside bounds at the
+/// plane.
+template <typename Context>
+class SpatialSplitter {
+public:
+    using Split = SpatialSplit;
+
+    static constexpr int NumBins = SpatialSplit::NumBins;
+
+    /// The number of references may grow to (1 + maxDuplication) times the
+    /// number of primitives.
+    SpatialSplitter(const Context & ctx, const Bounds3f & rootBounds,
+                    size_t numPrimitives, float alpha = 1e-5f,
+                    float maxDuplication = 1.f)
+        : _ctx(ctx),
+        _minOverlap(alpha * rootBounds.SurfaceArea()),
+        _maxReferences(numPrimitives * (1.f + maxDuplication)),
+        _numReferences(numPrimitives) {}
+
+    template <typename BuildRecord>
+    Split Find(BuildRecord & cur) const {
+        using PrimInfo = typename BuildRecord::PrimInfo;
+
+        Split split(_objectSplitter.Find(cur));
+        const BinSplit & objectSplit = split.objectSplit;
+        if (objectSplit.dim == static_cast<size_t>(-1)) {
+            return split;
+        }
+
+        // Cost and overlap of the object split, using the primitive bounds
+        Bounds3f leftBounds;
+        Bounds3f rightBounds;
+        for (const PrimInfo & info : cur.primInfo) {
+            int bin = objectSplit.mapping.Bin(info.centroid)[objectSplit.dim];
+            if (static_cast<size_t>(bin) <= objectSplit.pos) {
+                leftBounds.ExpandBy(info.bounds);
+            } else {
+                rightBounds.ExpandBy(info.bounds);
+            }
+        }
+        float objectSAH = objectSplit.leftCount * leftBounds.SurfaceArea()
+                          + objectSplit.rightCount * rightBounds.SurfaceArea();
+
+        Bounds3f overlap = Intersection(leftBounds, rightBounds);
+        if (IsEmpty(overlap) || overlap.SurfaceArea() <= _minOverlap) {
+            return split;
+        }
+
+        // Give up on spatial splits once the budget is used up
+        if (_numReferences.load() + cur.primInfo.size() > _maxReferences) {
+            return split;
+        }
+
+        float bestSAH = objectSAH;
+        for (size_t d = 0; d < 3; ++d) {
+            float extent = cur.bounds.max()[d] - cur.bounds.min()[d];
+            if (extent <= Epsilon) {
+                continue;
+            }
+
+            Split candidate(objectSplit);
+            candidate.dim = d;
+            candidate.offset = cur.bounds.min()[d];
+            candidate.scale = NumBins / extent;
+
+            // Clip every reference into the bins it overlaps
+            Bounds3f binBounds[NumBins];
+            size_t entries[NumBins]{};
+            size_t exits[NumBins]{};
+            for (const PrimInfo & info : cur.primInfo) {
+                int b0 = candidate.Bin(info.bounds.min()[d]);
+                int b1 = candidate.Bin(info.bounds.max()[d]);
+                entries[b0]++;
+                exits[b1]++;
+
+                Bounds3f rest = info.bounds;
+                for (int b = b0; b < b1; ++b) {
+                    Bounds3f left;
+                    Bounds3f right;
+                    info.prim->SplitBounds(_ctx, rest, d,
+                                           PlanePosition(candidate, b + 1),
+                                           &left, &right);
+                    binBounds[b].ExpandBy(left);
+                    rest = right;
+                }
+                binBounds[b1].ExpandBy(rest);
+            }
+
+            // Sweep from the right
+            Bounds3f rightSweep[NumBins];
+            size_t rightCounts[NumBins]{};
+            Bounds3f bounds;
+            size_t count = 0;
+            for (int b = NumBins; b-- > 0;) {
+                bounds.ExpandBy(binBounds[b]);
+                count += exits[b];
+                rightSweep[b] = bounds;
+                rightCounts[b] = count;
+            }
+
+            // Sweep from the left and evaluate the planes
+            bounds = Bounds3f();
+            count = 0;
+            for (int p = 0; p < NumBins - 1; ++p) {
+                bounds.ExpandBy(binBounds[p]);
+                count += entries[p];
+                if (count == 0 || rightCounts[p + 1] == 0) {
+                    continue;
+                }
+
+                float sah = count * bounds.SurfaceArea()
+                            + rightCounts[p + 1]
+                            * rightSweep[p + 1].SurfaceArea();
+                if (sah < bestSAH) {
+                    bestSAH = sah;
+                    split = candidate;
+                    split.spatial = true;
+                    split.plane = p;
+                    split.pos = PlanePosition(candidate, p + 1);
+                }
+            }
+        }
+
+        return split;
+    }
+
+    template <typename BuildRecord>
+    void PerformSplit(const BuildRecord & cur, const Split & split,
+                      BuildRecord & left, BuildRecord & right) const {
+
+        using PrimInfo = typename BuildRecord::PrimInfo;
+
+        if (!split.spatial) {
+            _objectSplitter.PerformSplit(cur, split.objectSplit, left, right);
+            return;
         }
+
+        // Distribute the references, clipping the ones on the plane
+        std::vector<PrimInfo> leftInfo;
+        std::vector<PrimInfo> rightInfo;
+        for (const PrimInfo & info : cur.primInfo) {
+            int b0 = split.Bin(info.bounds.min()[split.dim]);
+            int b1 = split.Bin(info.bounds.max()[split.dim]);
+            if (b1 <= split.plane) {
+                leftInfo.push_back(info);
+            } else if (b0 > split.plane) {
+                rightInfo.push_back(info);
+            } else {
+                Bounds3f leftBounds;
+                Bounds3f rightBounds;
+                info.prim->SplitBounds(_ctx, info.bounds, split.dim, split.pos,
+                                       &leftBounds, &rightBounds);
+                if (!IsEmpty(leftBounds)) {
+                    leftInfo.push_back(
+                            {leftBounds, leftBounds.Center(), info.prim});
+                }
+                if (!IsEmpty(rightBounds)) {
+                    rightInfo.push_back(
+                            {rightBounds, rightBounds.Center(), info.prim});
+                }
+            }
+        }
+        _numReferences.fetch_add(leftInfo.size() + rightInfo.size()
+                                 - cur.primInfo.size());
+
+        left.primInfo = Store(leftInfo);
+        ComputeRecordBounds(left);
+
+        right.primInfo = Store(rightInfo);
+        ComputeRecordBounds(right);
+    }
+
+private:
+    static bool IsEmpty(const Bounds3f & bounds) {
+        for (size_t d = 0; d < 3; ++d) {
+            if (bounds.min()[d] > bounds.max()[d]) {
+                return true;
+            }
+        }
+        return false;
     }
+
+    static float PlanePosition(const Split & split, int plane) {
+        return split.offset + plane / split.scale;
+    }
+
+    /// Copies references into memory that lives as long as the splitter
+    template <typename PrimInfo>
+    span<PrimInfo> Store(const std::vector<PrimInfo> & info) const {
+        PrimInfo * data;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            data = static_cast<PrimInfo *>(_alloc.Alloc(
+                    sizeof(PrimInfo) * info.size(), alignof(PrimInfo)));
+        }
+        std::uninitialized_copy(info.begin(), info.end(), data);
+        return span<PrimInfo>(data, info.size());
+    }
+
+    const Context & _ctx;
+    ObjectSplitter _objectSplitter;
+    float _minOverlap;
+    size_t _maxReferences;
+
+    mutable std::atomic<size_t> _numReferences;
+    mutable Allocator _alloc;
+    mutable std::mutex _mutex;
 };
 
 } // namespace renoster
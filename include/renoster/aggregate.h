@@ -0,0 +1,34 @@
+#ifndef RENOSTER_AGGREGATE_H_
+#define RENOSTER_AGGREGATE_H_
+
+#include <memory>
+#include <vector>
+
+#include "renoster/bvh.h"
+#include "renoster/primitive.h"
+
+namespace renoster {
+
+/// Aggregate holds the primitives of an object definition and a BVH over
+/// them. The BVH is built in object space, rays are transformed into it
+/// with the context, so one aggregate is shared by all its instances.
+class Aggregate : public Primitive {
+public:
+    explicit Aggregate(std::vector<std::shared_ptr<Primitive>> primitives);
+
+    bool Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
+                   ShadingPoint * sp) const;
+
+    bool Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const;
+
+    Bounds3f GetWorldBounds(const PrimitiveContext & ctx) const;
+
+private:
+    std::vector<std::shared_ptr<Primitive>> _primitives;
+    std::unique_ptr<BVH> _bvh;
+    Bounds3f _bounds;
+};
+
+}  // namespace renoster
+
+#endif  // RENOSTER_AGGREGATE_H_
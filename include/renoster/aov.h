@@ -0,0 +1,54 @@
+#ifndef RENOSTER_AOV_H_
+#define RENOSTER_AOV_H_
+
+#include <string>
+
+#include "renoster/export.h"
+
+namespace renoster {
+
+/// Aov lists the outputs of the film. Besides the color and the number of
+/// samples taken, integrators write the AOVs of the surface the camera ray
+/// hits.
+enum class Aov {
+    kColor,
+    kDepth,
+    kNormal,
+    kAlbedo,
+    kPosition,
+    kPrimitiveId,
+    kSampleCount,
+
+    kNumAovs
+};
+
+constexpr int NumAovs = static_cast<int>(Aov::kNumAovs);
+
+/// AovFilter tells how the samples of a pixel are combined
+enum class AovFilter {
+    /// Weighted by the pixel filter, like the color
+    kAverage,
+    /// Smallest value of the samples taken in the pixel
+    kMin,
+    /// Value of the sample taken in the pixel with the smallest depth
+    kClosest,
+    /// Number of samples taken in the pixel
+    kCount
+};
+
+struct AovInfo {
+    Aov aov;
+    AovFilter filter;
+    const char * name;
+    int numChannels;
+    const char * channelNames[3];
+};
+
+RENO_API const AovInfo & GetAovInfo(Aov aov);
+
+/// Finds the AOV of a name, returns false if there is none
+RENO_API bool FindAov(const std::string & name, Aov * aov);
+
+}  // namespace renoster
+
+#endif  // RENOSTER_AOV_H_
@@ -1,14 +1,18 @@
 #ifndef RENOSTER_BVH_H_
 #define RENOSTER_BVH_H_
 
+#include <cstdint>
+#include <new>
 #include <vector>
 
 #include "renoster/bounds.h"
 #include "renoster/geometry.h"
+#include "renoster/log.h"
 #include "renoster/matrix.h"
 #include "renoster/position.h"
 #include "renoster/ray.h"
 #include "renoster/shading.h"
+#include "renoster/stats.h"
 #include "renoster/util/allocator.h"
 #include "renoster/util/tagged_pointer.h"
 #include "renoster/util/vbool4.h"
@@ -54,15 +58,19 @@ class RENO_API BVH {
 public:
     struct BaseNode;
     struct AlignedNode;
+    struct AlignedNode8;
     template <typename P> struct LeafNode;
 
     enum NodeType {
         kLeaf = 0x0001,
         kUnaligned = 0x0002,
         kMotion = 0x0004,
-        kMotion4D = 0x0008
+        kMotion4D = 0x0008,
+        kWide = 0x0010
     };
 
+    static constexpr size_t MaxStackSize = 256;
+
     struct NodeRef {
     public:
         NodeRef() {}
@@ -70,6 +78,9 @@ public:
         NodeRef(AlignedNode * node)
             : ptr_(AlignedNode::Type, node) {}
 
+        NodeRef(AlignedNode8 * node)
+            : ptr_(AlignedNode8::Type, node) {}
+
         template <typename Primitive>
         NodeRef(LeafNode<Primitive> * leaf)
             : ptr_(LeafNode<Primitive>::Type, leaf) {}
@@ -80,6 +91,10 @@ public:
             return static_cast<BaseNode *>(ptr_.get());
         }
 
+        AlignedNode8 * GetWideNode() const {
+            return static_cast<AlignedNode8 *>(ptr_.get());
+        }
+
         template <typename Primitive>
         LeafNode<Primitive> * GetLeafNode() const {
             return static_cast<LeafNode<Primitive> *>(ptr_.get());
@@ -146,25 +161,157 @@ public:
         Bounds1v4f timeBounds;
     };
 
+    /// AlignedNode8 stores the bounds of eight children. It is only created
+    /// when the CPU supports AVX2, which the traversal kernel requires.
+    struct AlignedNode8 {
+        static constexpr uint16_t Type = kWide;
+
+        NodeRef children[8];
+        alignas(32) float lower[3][8];
+        alignas(32) float upper[3][8];
+    };
+
+    /// QuantizedNode stores the bounds of four children with 8 bits per
+    /// plane, relative to the bounds of the node. The nodes live in a single
+    /// array and refer to their children by index, so a node fills exactly
+    /// one cache line.
+    struct alignas(64) QuantizedNode {
+        static constexpr uint32_t Empty = 0xffffffff;
+        static constexpr uint32_t LeafFlag = 0x80000000;
+
+        QuantizedNode() = default;
+
+        /// Quantizes the child bounds of node conservatively, the decoded
+        /// bounds always contain the original ones.
+        explicit QuantizedNode(const AlignedNode & node);
+
+        vbool4 Intersect(const TraversalRay & ray, vfloat4 & dist) const;
+
+        float origin[3];
+        float scale[3];
+        uint8_t lower[3][4];
+        uint8_t upper[3][4];
+        uint32_t children[4];
+    };
+
+    /// LeafNode stores the pointers to its primitives right after itself.
+    /// Geometries can specialize it to store their primitives in a format
+    /// that is faster to intersect.
     template <typename Primitive>
     struct LeafNode {
         static constexpr uint16_t Type = kLeaf;
 
+        /// Returns the number of bytes of a leaf with numPrimitives
+        /// primitives
+        static size_t GetSize(size_t numPrimitives) {
+            return sizeof(LeafNode) + numPrimitives * sizeof(Primitive *);
+        }
+
+        /// Creates a leaf in bytes, which holds GetSize(numPrimitives) bytes
+        static LeafNode * Create(void * bytes, Primitive * const * prims,
+                                 size_t numPrimitives) {
+            LeafNode * leaf = new (bytes) LeafNode;
+            leaf->numPrimitives = numPrimitives;
+            leaf->primitives = reinterpret_cast<Primitive **>(leaf + 1);
+            for (size_t i = 0; i < numPrimitives; ++i) {
+                leaf->primitives[i] = prims[i];
+            }
+            return leaf;
+        }
+
+        template <typename PrimitiveContext>
+        bool Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
+                       ShadingPoint * sp) const {
+            RENO_STAT_ADD(Stat::kPrimitiveTests, numPrimitives);
+            bool hit = false;
+            for (size_t i = 0; i < numPrimitives; ++i) {
+                hit |= primitives[i]->Intersect(ctx, ray, sp);
+            }
+            return hit;
+        }
+
+        template <typename PrimitiveContext>
+        bool Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const {
+            for (size_t i = 0; i < numPrimitives; ++i) {
+                RENO_STAT_ADD(Stat::kPrimitiveTests, 1);
+                if (primitives[i]->Occluded(ctx, ray)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         size_t numPrimitives;
         Primitive ** primitives;
     };
 
     BVH() = default;
 
+    /// Returns the widest node the CPU can traverse, either 4 or 8
+    static size_t NativeWidth();
+
     template <typename Primitive, typename PrimitiveContext>
     bool Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
-                   ShadingPoint * sp) const;
+                   ShadingPoint * sp) const {
+        return Intersect<Primitive>(ctx, ray, ray, sp);
+    }
+
+    template <typename Primitive, typename PrimitiveContext>
+    bool Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const {
+        return Occluded<Primitive>(ctx, ray, ray);
+    }
 
+    /// Traverses the hierarchy with localRay, the ray in the space the
+    /// hierarchy was built in, and passes ray to the primitives. Both rays
+    /// must share their parametrization, so that hits on ray shorten the
+    /// traversal of localRay.
     template <typename Primitive, typename PrimitiveContext>
-    bool Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const;
+    bool Intersect(const PrimitiveContext & ctx, const Ray3f & localRay,
+                   const Ray3f & ray, ShadingPoint * sp) const;
+
+    template <typename Primitive, typename PrimitiveContext>
+    bool Occluded(const PrimitiveContext & ctx, const Ray3f & localRay,
+                  const Ray3f & ray) const;
+
+    /// Returns the SAH cost of the hierarchy, i.e. the expected cost of
+    /// tracing a ray that hits the root.
+    template <typename Primitive>
+    float SAHCost(float traversalCost = 1.f,
+                  float intersectionCost = 1.f) const;
+
+    /// Replaces a 4-wide hierarchy with QuantizedNodes and frees the
+    /// original nodes
+    template <typename Primitive>
+    void Quantize();
+
+    /// Returns the number of bytes used by the nodes and leaves
+    template <typename Primitive>
+    size_t MemoryUsage() const;
 
     NodeRef _root;
+
+    /// Inner nodes and leaves are allocated separately, so the inner nodes
+    /// can be freed after quantization
     Allocator _alloc;
+    Allocator _leafAlloc;
+
+    /// The quantized hierarchy, only used after Quantize()
+    uint32_t _quantizedRoot = QuantizedNode::Empty;
+    std::vector<QuantizedNode> _quantizedNodes;
+    std::vector<NodeRef> _quantizedLeaves;
+
+private:
+    template <typename Primitive>
+    uint32_t QuantizeRecursive(NodeRef ref);
+
+    template <typename Primitive, typename PrimitiveContext>
+    bool IntersectQuantized(const PrimitiveContext & ctx,
+                            const Ray3f & localRay, const Ray3f & ray,
+                            ShadingPoint * sp) const;
+
+    template <typename Primitive, typename PrimitiveContext>
+    bool OccludedQuantized(const PrimitiveContext & ctx,
+                           const Ray3f & localRay, const Ray3f & ray) const;
 };
 
 void TraverseNode(const BVH::BaseNode * node, vfloat4 vdist, vbool4 vmask,
@@ -173,16 +320,31 @@ void TraverseNode(const BVH::BaseNode * node, vfloat4 vdist, vbool4 vmask,
 void TraverseNodeOccluded(const BVH::BaseNode * node, vfloat4 vdist,
                           vbool4 vmask, BVH::NodeRef *& stackPtr);
 
+// Defined in bvh8.cpp, whose kernels are compiled for AVX2
+void TraverseNode8(const BVH::AlignedNode8 * node, const TraversalRay & ray,
+                   BVH::NodeRef *& stackPtr);
+
+void TraverseNode8Occluded(const BVH::AlignedNode8 * node,
+                           const TraversalRay & ray,
+                           BVH::NodeRef *& stackPtr);
+
+void TraverseQuantizedNode(const BVH::QuantizedNode & node, vfloat4 vdist,
+                           vbool4 vmask, uint32_t *& stackPtr);
+
 template <typename Primitive, typename PrimitiveContext>
-bool BVH::Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
-                    ShadingPoint * sp) const
+bool BVH::Intersect(const PrimitiveContext & ctx, const Ray3f & localRay,
+                    const Ray3f & ray, ShadingPoint * sp) const
 {
+    if (_quantizedRoot != QuantizedNode::Empty) {
+        return IntersectQuantized<Primitive>(ctx, localRay, ray, sp);
+    }
+
     // Prepare ray for traversal
-    TraversalRay travRay(ray);
+    TraversalRay travRay(localRay);
 
     vfloat4 vdist;
     bool hit = false;
-    BVH::NodeRef stack[64];
+    BVH::NodeRef stack[MaxStackSize];
     BVH::NodeRef * stackPtr = stack + 1;
     stack[0] = _root;
 
@@ -191,6 +353,13 @@ bool BVH::Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
 
         uint16_t type = cur.GetType();
         if (type != BVH::LeafNode<Primitive>::Type) {
+            RENO_STAT_ADD(Stat::kNodeVisits, 1);
+        } else {
+            RENO_STAT_ADD(Stat::kLeafVisits, 1);
+        }
+        if (type == BVH::AlignedNode8::Type) {
+            TraverseNode8(cur.GetWideNode(), travRay, stackPtr);
+        } else if (type != BVH::LeafNode<Primitive>::Type) {
             // Get the node
             BVH::BaseNode * node = cur.GetBaseNode();
 
@@ -204,10 +373,8 @@ bool BVH::Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
             BVH::LeafNode<Primitive> * leaf = cur.GetLeafNode<Primitive>();
 
             //
-            for (int i = 0; i < leaf->numPrimitives; ++i) {
-                hit |= leaf->primitives[i]->Intersect(ctx, ray, sp);
-            }
-            
+            hit |= leaf->Intersect(ctx, ray, sp);
+
             //
             travRay.tMax = vfloat4(ray.tMax());
         }
@@ -217,13 +384,18 @@ bool BVH::Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
 }
 
 template <typename Primitive, typename PrimitiveContext>
-bool BVH::Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const
+bool BVH::Occluded(const PrimitiveContext & ctx, const Ray3f & localRay,
+                   const Ray3f & ray) const
 {
+    if (_quantizedRoot != QuantizedNode::Empty) {
+        return OccludedQuantized<Primitive>(ctx, localRay, ray);
+    }
+
     // Prepare ray for traversal
-    TraversalRay travRay(ray);
+    TraversalRay travRay(localRay);
 
     vfloat4 vdist;
-    BVH::NodeRef stack[64];
+    BVH::NodeRef stack[MaxStackSize];
     BVH::NodeRef * stackPtr = stack + 1;
     stack[0] = _root;
 
@@ -232,6 +404,13 @@ bool BVH::Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const
 
         uint16_t type = cur.GetType();
         if (type != BVH::LeafNode<Primitive>::Type) {
+            RENO_STAT_ADD(Stat::kNodeVisits, 1);
+        } else {
+            RENO_STAT_ADD(Stat::kLeafVisits, 1);
+        }
+        if (type == BVH::AlignedNode8::Type) {
+            TraverseNode8Occluded(cur.GetWideNode(), travRay, stackPtr);
+        } else if (type != BVH::LeafNode<Primitive>::Type) {
             // Get the node
             BVH::BaseNode * node = cur.GetBaseNode();
 
@@ -245,20 +424,243 @@ bool BVH::Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const
             auto * leaf = cur.GetLeafNode<Primitive>();
 
             //
-            for (int i = 0; i < leaf->numPrimitives; ++i) {
-                if(leaf->primitives[i]->Occluded(ctx, ray)) {
-                    return true;
+            if (leaf->Occluded(ctx, ray)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+template <typename Primitive>
+float BVH::SAHCost(float traversalCost, float intersectionCost) const
+{
+    struct Entry {
+        NodeRef node;
+        Bounds3f bounds;
+    };
+
+    if (_root.GetType() == LeafNode<Primitive>::Type) {
+        return intersectionCost * _root.GetLeafNode<Primitive>()->numPrimitives;
+    }
+
+    // Collects the children of an inner node with their bounds
+    auto pushChildren = [](NodeRef ref, std::vector<Entry> & entries) {
+        if (ref.GetType() == AlignedNode8::Type) {
+            const AlignedNode8 * node = ref.GetWideNode();
+            for (size_t i = 0; i < 8; ++i) {
+                if (node->children[i].GetBaseNode()) {
+                    entries.push_back({node->children[i], Bounds3f(
+                            Point3f(node->lower[0][i], node->lower[1][i],
+                                    node->lower[2][i]),
+                            Point3f(node->upper[0][i], node->upper[1][i],
+                                    node->upper[2][i]))});
                 }
             }
-            
-            //
+        } else {
+            const AlignedNode * node =
+                    static_cast<const AlignedNode *>(ref.GetBaseNode());
+            for (size_t i = 0; i < 4; ++i) {
+                if (node->children[i].GetBaseNode()) {
+                    entries.push_back({node->children[i], Bounds3f(
+                            Point3f(node->bounds.min().x()[i],
+                                    node->bounds.min().y()[i],
+                                    node->bounds.min().z()[i]),
+                            Point3f(node->bounds.max().x()[i],
+                                    node->bounds.max().y()[i],
+                                    node->bounds.max().z()[i]))});
+                }
+            }
+        }
+    };
+
+    // The root bounds are the union of the bounds of its children
+    std::vector<Entry> stack;
+    pushChildren(_root, stack);
+    Bounds3f rootBounds;
+    for (const Entry & entry : stack) {
+        rootBounds.ExpandBy(entry.bounds);
+    }
+    float rootArea = rootBounds.SurfaceArea();
+
+    float cost = traversalCost;
+    while (!stack.empty()) {
+        Entry cur = stack.back();
+        stack.pop_back();
+
+        float prob = cur.bounds.SurfaceArea() / rootArea;
+        if (cur.node.GetType() == LeafNode<Primitive>::Type) {
+            auto * leaf = cur.node.template GetLeafNode<Primitive>();
+            cost += prob * intersectionCost * leaf->numPrimitives;
+            continue;
+        }
+
+        cost += prob * traversalCost;
+        pushChildren(cur.node, stack);
+    }
+
+    return cost;
+}
+
+template <typename Primitive, typename PrimitiveContext>
+bool BVH::IntersectQuantized(const PrimitiveContext & ctx,
+                             const Ray3f & localRay, const Ray3f & ray,
+                             ShadingPoint * sp) const
+{
+    TraversalRay travRay(localRay);
+
+    vfloat4 vdist;
+    bool hit = false;
+    uint32_t stack[MaxStackSize];
+    uint32_t * stackPtr = stack + 1;
+    stack[0] = _quantizedRoot;
+
+    while (stackPtr != stack) {
+        uint32_t cur = *(--stackPtr);
+
+        if (!(cur & QuantizedNode::LeafFlag)) {
+            RENO_STAT_ADD(Stat::kNodeVisits, 1);
+            const QuantizedNode & node = _quantizedNodes[cur];
+            vbool4 vmask = node.Intersect(travRay, vdist);
+            TraverseQuantizedNode(node, vdist, vmask, stackPtr);
+        } else {
+            RENO_STAT_ADD(Stat::kLeafVisits, 1);
+            NodeRef leaf = _quantizedLeaves[cur & ~QuantizedNode::LeafFlag];
+            hit |= leaf.template GetLeafNode<Primitive>()->Intersect(
+                    ctx, ray, sp);
             travRay.tMax = vfloat4(ray.tMax());
         }
     }
 
+    return hit;
+}
+
+template <typename Primitive, typename PrimitiveContext>
+bool BVH::OccludedQuantized(const PrimitiveContext & ctx,
+                            const Ray3f & localRay, const Ray3f & ray) const
+{
+    TraversalRay travRay(localRay);
+
+    vfloat4 vdist;
+    uint32_t stack[MaxStackSize];
+    uint32_t * stackPtr = stack + 1;
+    stack[0] = _quantizedRoot;
+
+    while (stackPtr != stack) {
+        uint32_t cur = *(--stackPtr);
+
+        if (!(cur & QuantizedNode::LeafFlag)) {
+            RENO_STAT_ADD(Stat::kNodeVisits, 1);
+            const QuantizedNode & node = _quantizedNodes[cur];
+            vbool4 vmask = node.Intersect(travRay, vdist);
+            size_t mask = MoveMask(vmask);
+            for (size_t i = 0; i < 4; ++i) {
+                if ((mask & (1 << i)) &&
+                    node.children[i] != QuantizedNode::Empty) {
+                    *(stackPtr++) = node.children[i];
+                }
+            }
+        } else {
+            RENO_STAT_ADD(Stat::kLeafVisits, 1);
+            NodeRef leaf = _quantizedLeaves[cur & ~QuantizedNode::LeafFlag];
+            if (leaf.template GetLeafNode<Primitive>()->Occluded(ctx, ray)) {
+                return true;
+            }
+        }
+    }
+
     return false;
 }
 
+template <typename Primitive>
+void BVH::Quantize()
+{
+    if (_root.GetType() != LeafNode<Primitive>::Type &&
+        _root.GetType() != AlignedNode::Type) {
+        Error("BVH::Quantize(): only 4-wide hierarchies can be quantized");
+        return;
+    }
+
+    _quantizedRoot = QuantizeRecursive<Primitive>(_root);
+
+    // The original inner nodes are no longer referenced
+    _root = NodeRef();
+    _alloc.Release();
+}
+
+template <typename Primitive>
+uint32_t BVH::QuantizeRecursive(NodeRef ref)
+{
+    // Leaves are kept as they are
+    if (ref.GetType() == LeafNode<Primitive>::Type) {
+        _quantizedLeaves.push_back(ref);
+        return static_cast<uint32_t>(_quantizedLeaves.size() - 1) |
+               QuantizedNode::LeafFlag;
+    }
+
+    // Store the children right after their parent, depth first
+    const AlignedNode * node =
+            static_cast<const AlignedNode *>(ref.GetBaseNode());
+    uint32_t index = static_cast<uint32_t>(_quantizedNodes.size());
+    _quantizedNodes.emplace_back(*node);
+    for (size_t i = 0; i < 4; ++i) {
+        if (node->children[i].GetBaseNode()) {
+            uint32_t child = QuantizeRecursive<Primitive>(node->children[i]);
+            _quantizedNodes[index].children[i] = child;
+        }
+    }
+    return index;
+}
+
+template <typename Primitive>
+size_t BVH::MemoryUsage() const
+{
+    auto leafSize = [](NodeRef ref) {
+        auto * leaf = ref.template GetLeafNode<Primitive>();
+        return LeafNode<Primitive>::GetSize(leaf->numPrimitives);
+    };
+
+    size_t numBytes = 0;
+    if (_quantizedRoot != QuantizedNode::Empty) {
+        numBytes += _quantizedNodes.size() * sizeof(QuantizedNode);
+        for (NodeRef leaf : _quantizedLeaves) {
+            numBytes += leafSize(leaf);
+        }
+        return numBytes;
+    }
+
+    std::vector<NodeRef> stack = {_root};
+    while (!stack.empty()) {
+        NodeRef cur = stack.back();
+        stack.pop_back();
+
+        if (cur.GetType() == LeafNode<Primitive>::Type) {
+            numBytes += leafSize(cur);
+            continue;
+        }
+
+        const NodeRef * children;
+        size_t numChildren;
+        if (cur.GetType() == AlignedNode8::Type) {
+            numBytes += sizeof(AlignedNode8);
+            children = cur.GetWideNode()->children;
+            numChildren = 8;
+        } else {
+            numBytes += sizeof(AlignedNode);
+            children = cur.GetBaseNode()->children;
+            numChildren = 4;
+        }
+        for (size_t i = 0; i < numChildren; ++i) {
+            if (children[i].GetBaseNode()) {
+                stack.push_back(children[i]);
+            }
+        }
+    }
+
+    return numBytes;
+}
+
 }  // namespace renoster
 
 #endif  // RENOSTER_BVH_H_
@@ -123,6 +123,10 @@ public:
 
     float ChannelAvg() const { return (_r + _g + _b) / 3.f; }
 
+    float Luminance() const {
+        return 0.2126f * _r + 0.7152f * _g + 0.0722f * _b;
+    }
+
     friend bool operator==(const Color & lhs, const Color & rhs) {
         return lhs._r == rhs._r && lhs._g == rhs._g && lhs._b == rhs._b;
     }
@@ -2,7 +2,10 @@
 #define RENOSTER_DISPLAY_H_
 
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "renoster/bounds.h"
 #include "renoster/export.h"
 #include "renoster/paramlist.h"
 #include "renoster/vector.h"
@@ -11,10 +14,28 @@ namespace renoster {
 
 class RENO_API Display {
 public:
-    virtual bool Open(const Vector2i & resolution) = 0;
+    /// Opens the display for an image with the named channels. Pixels
+    /// are passed with their channels interleaved.
+    virtual bool Open(const Vector2i & resolution,
+                      const std::vector<std::string> & channelNames) = 0;
 
     virtual bool WriteData(float * pixels) = 0;
 
+    /// Opens the display for tiles written with WriteTile(), instead of a
+    /// whole image. Returns false if the display only takes whole images.
+    virtual bool OpenTiles(const Vector2i & resolution,
+                           const Vector2i & tileSize,
+                           const std::vector<std::string> & channelNames) {
+        return false;
+    }
+
+    /// Writes the pixels of a tile in scanlines. Tiles lie on the grid of
+    /// the tile size, the ones at the right and bottom edges may be
+    /// smaller. Tiles are written in any order, but not concurrently.
+    virtual bool WriteTile(const Bounds2i & bounds, float * pixels) {
+        return false;
+    }
+
     virtual bool Close() = 0;
 
     virtual std::string GetError() = 0;
@@ -1,10 +1,14 @@
 #ifndef RENOSTER_FILM_H_
 #define RENOSTER_FILM_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "renoster/aov.h"
 #include "renoster/bounds.h"
 #include "renoster/color.h"
 #include "renoster/export.h"
@@ -17,6 +21,7 @@
 namespace renoster {
 
 class Display;
+class DisplayTileWriter;
 class Film;
 class PixelFilter;
 class Sampler;
@@ -26,9 +31,51 @@ enum class FilmSampleMode {
     kImportance
 };
 
-struct Pixel {
-    Color contribSum = Color(0.f);
-    float weightSum = 0.f;
+/// FilmPixel is a pixel of the film. Tiles are merged without locks, the
+/// pixels they share with other tiles are updated atomically.
+///
+/// It holds the weighted sums of the samples of the pixel. The sums of the
+/// squared luminance and weights estimate the error of the pixel, and the
+/// sample count only counts the samples taken in the pixel itself.
+struct FilmPixel {
+    std::atomic<float> contribSum[3];
+    std::atomic<float> weightSum;
+    std::atomic<float> luminanceSqSum;
+    std::atomic<float> weightSqSum;
+    std::atomic<int> sampleCount;
+};
+
+/// AovLayout places the AOVs of the film in the pixels. The color and the
+/// sample count are part of every pixel. Averaged AOVs add weighted sums,
+/// the others a key per pixel, which orders the samples by depth.
+struct AovLayout {
+    AovLayout() = default;
+
+    explicit AovLayout(const std::vector<Aov> & aovs);
+
+    /// The AOVs written to the display, in order
+    std::vector<Aov> aovs;
+    std::vector<std::string> channelNames;
+
+    /// The AOVs with sums and with keys
+    std::vector<Aov> sumAovs;
+    std::vector<Aov> keyAovs;
+
+    /// Index of the first sum or key of every AOV in a pixel
+    int offsets[NumAovs] = {};
+    int numSums = 0;
+    int numKeys = 0;
+};
+
+/// CheckpointProgress is stored with the pixels of a checkpoint. A render
+/// with the same samples per pixel resumes after the stored samples, the
+/// passes may be sized differently. It takes the same samples as an
+/// uninterrupted render, whose pixels it matches up to float summation
+/// order.
+struct CheckpointProgress {
+    int32_t samplesPerPixel = 0;
+    int32_t numSamples = 0;
+    int32_t numPasses = 0;
 };
 
 /// FilmTile represents a part of the
@@ -36,7 +83,8 @@ class RENO_API FilmTile {
 public:
     FilmTile(int tileId, const Point2i & index, const Bounds2i & pixelBounds,
              const Bounds2i & sampleBounds, const PixelFilter * filter,
-             const FilterTable * filterTable, FilmSampleMode sampleMode);
+             const FilterTable * filterTable, FilmSampleMode sampleMode,
+             const AovLayout * aovLayout);
 
     Point2f Sample(const Point2i & pixel, Sampler * sampler, float * pdf);
 
@@ -56,7 +104,9 @@ public:
     }
 
 private:
-    Pixel & GetPixel(const Point2i & p);
+    int GetPixelOffset(const Point2i & p) const;
+
+    void AddAovKeys(int offset, const FilmAccumulator & accum);
 
     ///
     int _tileId;
@@ -71,6 +121,9 @@ private:
     /// The pixels we need to sample
     Bounds2i _sampleBounds;
 
+    /// The pixels no other tile stores values for
+    Bounds2i _ownedBounds;
+
     /// Pixel filter of the film
     const PixelFilter * _filter;
 
@@ -80,29 +133,59 @@ private:
     /// Sample mode of the film
     FilmSampleMode _sampleMode;
 
-    /// Pixels stored in scanlines
-    std::vector<Pixel> _pixels;
+    /// AOVs of the film
+    const AovLayout * _aovLayout;
+
+    /// Number of pixels, and the size of a plane of the sums
+    int _numPixels;
+    int _planeSize;
+
+    /// Sums of the pixels. Every sum is stored in scanlines in a plane of
+    /// its own, so the sums of a row of pixels are added with vectors. The
+    /// planes of the AOV sums follow the ones of the color.
+    std::vector<float> _sums;
+
+    /// Sample counts and AOV keys of the pixels
+    std::vector<int> _sampleCounts;
+    std::vector<uint64_t> _aovKeys;
+
+    /// Filter radius, and the weights of a row of the pixels around a
+    /// sample
+    Vector2f _filterRadius;
+    std::vector<float> _weights;
 
     friend class Film;
 };
 
+/// TileGenerator hands out the tiles of the film. Besides the scanline
+/// orders, it supports a spiral from the centre, for a quick preview of
+/// the subject, and Hilbert and Morton curves, which hand out neighbouring
+/// tiles consecutively so their data stays in the shared caches.
+///
+/// The last numSplitTiles tiles are handed out as four sub-tiles each, so
+/// the threads run out of work at about the same time at the end of a
+/// frame. Tiles are taken with an atomic counter.
 class RENO_API TileGenerator {
 public:
     enum class Order {
         kHorizontal,
         kVertical,
-        kSpiral
+        kSpiral,
+        kHilbert,
+        kMorton
     };
 
-    TileGenerator(Order order, const Vector2i & nTiles);
+    TileGenerator(Order order, const Vector2i & nTiles, int numSplitTiles);
 
-    bool GenerateNextTile(Point2i & tileIndex);
+    /// Returns the next tile, and the quadrant of it in subTile, or -1 for
+    /// the whole tile
+    bool GenerateNextTile(Point2i & tileIndex, int & subTile);
 
 private:
-    Order _order;
-    Vector2i _nTiles;
-    int _index;
-    std::mutex _mutex;
+    /// The tile indices in the order they are handed out
+    std::vector<Point2i> _tiles;
+    int _numSplitTiles;
+    std::atomic<int> _index;
 };
 
 class RENO_API Film {
@@ -110,14 +193,71 @@ public:
     Film(const Vector2i & resolution, float pixelAspectRatio,
          const Bounds2f & cropWindow, float frameAspectRatio,
          const Bounds2f & screenWindow, const Vector2i & tileSize,
-         int filterTableSize, FilmSampleMode sampleMode);
+         TileGenerator::Order tileOrder, int filterTableSize,
+         FilmSampleMode sampleMode, float adaptiveThreshold,
+         int adaptiveMinSamples);
 
-    void RenderBegin(PixelFilter * filter, Display * display);
+    ~Film();
+
+    /// The display receives the channels of the AOVs, the color if there
+    /// are none
+    void RenderBegin(PixelFilter * filter, Display * display,
+                     const std::vector<Aov> & aovs = std::vector<Aov>());
 
     void RenderEnd();
 
+    /// Starts a pass over the film, which hands out all tiles again. If
+    /// the display takes tiles, the last pass writes every tile of the
+    /// image as soon as the film tiles overlapping it are merged.
+    void StartPass(bool lastPass);
+
+    /// Writes the pixels accumulated so far to the display in the
+    /// background. The update is skipped if the display is still busy with
+    /// the previous one, so the caller never waits for it.
+    void UpdateDisplay();
+
     std::unique_ptr<FilmTile> GetNextTile() const;
 
+    /// Returns true if pixels stop taking samples once their error estimate
+    /// falls below the threshold
+    bool IsAdaptive() const {
+        return _adaptiveThreshold > 0.f;
+    }
+
+    /// Returns the number of samples a pixel takes before its error
+    /// estimate is trusted
+    int GetAdaptiveMinSamples() const {
+        return _adaptiveMinSamples;
+    }
+
+    /// Returns true if the pixel needs no more samples. Pixels sampled
+    /// for the filter border follow the closest pixel of the film.
+    bool IsConverged(const Point2i & pixel) const;
+
+    /// Marks the pixels whose error estimate is below the threshold as
+    /// converged, and returns the number of pixels that are not. No tiles
+    /// may be rendered meanwhile.
+    int64_t UpdateConvergence();
+
+    /// Returns the average number of samples taken in the pixels, and the
+    /// average error estimate of the pixels with enough samples for one
+    void EstimateConvergence(double * meanSamples, double * meanError);
+
+    /// Writes the pixels and the progress to a checkpoint file in the
+    /// background. The checkpoint is skipped if the previous one is still
+    /// being written. No tiles may be rendered meanwhile.
+    void WriteCheckpoint(const std::string & filename,
+                         const CheckpointProgress & progress);
+
+    /// Waits until the checkpoint being written is complete
+    void WaitForCheckpoint();
+
+    /// Replaces the pixels by the ones of a checkpoint of this film, if it
+    /// was written with the samples per pixel of progress. Sets the samples
+    /// and passes of progress to the stored ones.
+    bool ReadCheckpoint(const std::string & filename,
+                        CheckpointProgress * progress);
+
     void MergeFilmTile(std::unique_ptr<FilmTile> tile);
 
     Point2f RasterToScreen(const Point2f & p) const;
@@ -126,10 +266,38 @@ public:
         return _screenWindow;
     }
 
+    int GetNumTiles() const {
+        return _nTiles.x() * _nTiles.y();
+    }
+
 private:
+    Bounds2i GetTileSampleBounds(const Point2i & tileIndex) const;
+
+    Bounds2i GetPixelBounds(const Bounds2i & sampleBounds) const;
+
+    Bounds2i GetTilePixelBounds(const Point2i & tileIndex) const;
+
+    Bounds2i GetTileOwnedBounds(const Point2i & tileIndex) const;
+
+    void ResolveRegion(const Bounds2i & bounds, float * pixels);
+
+    void ResolvePixels();
+
+    void WriteToDisplay();
+
     void OutputToDisplay();
 
-    Pixel & GetPixel(const Point2i & p);
+    Bounds2i GetDisplayTileRange(const Point2i & tileIndex) const;
+
+    Bounds2i GetDisplayTileBounds(const Point2i & displayTile) const;
+
+    void FinishFilmTile(const Point2i & tileIndex);
+
+    void WriteDisplayTile(const Point2i & displayTile);
+
+    int GetPixelOffset(const Point2i & p) const;
+
+    FilmPixel & GetPixel(const Point2i & p);
 
     // Film Settings
     Vector2i _resolution;
@@ -138,8 +306,11 @@ private:
     float _frameAspectRatio;
     Bounds2f _screenWindow;
     Vector2i _tileSize;
+    TileGenerator::Order _tileOrder;
     int _filterTableSize;
     FilmSampleMode _sampleMode;
+    float _adaptiveThreshold;
+    int _adaptiveMinSamples;
 
     /// Number of tiles in each direction
     Vector2i _nTiles;
@@ -148,7 +319,38 @@ private:
     Bounds2i _pixelBounds;
 
     // Pixels stored in scanlines
-    std::vector<Pixel> _pixels;
+    std::unique_ptr<FilmPixel[]> _pixels;
+
+    // AOVs, and their sums and keys in scanlines
+    AovLayout _aovLayout;
+    std::unique_ptr<std::atomic<float>[]> _aovSums;
+    std::unique_ptr<std::atomic<uint64_t>[]> _aovKeys;
+
+    // Converged pixels of adaptive sampling, in scanlines
+    std::vector<uint8_t> _converged;
+
+    // Resolved pixels passed to the display
+    std::vector<float> _resolved;
+
+    // Thread writing intermediate images to the display
+    std::thread _displayThread;
+    std::atomic<bool> _displayBusy{false};
+
+    // Thread writing checkpoints, and the checkpoint it writes
+    std::thread _checkpointThread;
+    std::atomic<bool> _checkpointBusy{false};
+    std::vector<char> _checkpointData;
+
+    // Display tiles written while the last pass renders
+    std::unique_ptr<DisplayTileWriter> _tileWriter;
+    Vector2i _nDisplayTiles;
+
+    // Quarters of every film tile that are not merged yet
+    std::unique_ptr<std::atomic<int>[]> _filmTileParts;
+
+    // Film tiles overlapping every display tile that are not merged yet
+    std::unique_ptr<std::atomic<int>[]> _displayTileDeps;
+    std::vector<uint8_t> _displayTileWritten;
 
     // Filter and Display
     // Set in RenderBegin()
@@ -161,9 +363,6 @@ private:
     // Tile Generator
     std::unique_ptr<TileGenerator> _tileGen;
     std::unique_ptr<FilterTable> _filterTable;
-
-    /// Mutex for merging tiles
-    std::mutex _mutex;
 };
 
 RENO_API std::unique_ptr<Film> CreateFilm(ParameterList & params);
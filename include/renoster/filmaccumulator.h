@@ -1,6 +1,9 @@
 #ifndef RENOSTER_FILMACCUMULATOR_H_
 #define RENOSTER_FILMACCUMULATOR_H_
 
+#include <cstdint>
+
+#include "renoster/aov.h"
 #include "renoster/color.h"
 #include "renoster/export.h"
 
@@ -16,10 +19,19 @@ public:
 
     void GetValue(Color & value) const;
 
+    /// Writes an AOV of the sample. AOVs with a single channel use the
+    /// first one of the color.
+    void WriteAov(Aov aov, const Color & value);
+
+    /// Returns false if the AOV was not written for the sample
+    bool GetAov(Aov aov, Color & value) const;
+
     void Reset();
 
 private:
     Color value_;
+    Color aovs_[NumAovs];
+    uint32_t aovMask_;
 };
 
 } // namespace renoster
@@ -18,9 +18,17 @@ public:
 
     float Evaluate(const Point2f & p) const;
 
+    /// Evaluates the filter for the pixels around a sample, at the points
+    /// p + (x, y) of a width x height block. The weights are stored in rows.
+    void EvaluateFootprint(const Point2f & p, int width, int height,
+                           float * weights) const;
+
     float Sample(Point2f & p, const Point2f & uv, float * pdf) const;
 
 private:
+    /// Returns the index of a coordinate in the table
+    int GetIndex(float p, float invRadius) const;
+
     const PixelFilter * _filter;
     int _tableSize;
     Vector2f _radius;
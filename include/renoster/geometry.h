@@ -5,6 +5,7 @@
 
 #include "renoster/bounds.h"
 #include "renoster/export.h"
+#include "renoster/lightbounds.h"
 #include "renoster/paramlist.h"
 #include "renoster/position.h"
 #include "renoster/ray.h"
@@ -14,11 +15,12 @@
 
 namespace renoster {
 
-/// GeometryContext
+/// GeometryContext holds the transforms of a geometry
 class RENO_API GeometryContext {
 public:
     GeometryContext()
-        : WorldToObject(Identity()), ObjectToWorld(Identity()) {}
+        : WorldToObject(IdentityTransform()),
+        ObjectToWorld(IdentityTransform()) {}
 
     GeometryContext(const Transform & WorldToObject,
                     const Transform & ObjectToWorld)
@@ -65,6 +67,12 @@ public:
     virtual float Pdf(const GeometryContext & ctx, const ShadingPoint & ref,
                       const ShadingPoint & pos) const;
 
+    /// Calculate the surface area in world space
+    virtual float Area(const GeometryContext & ctx) const = 0;
+
+    /// Get a cone that contains the geometric normals in world space
+    virtual DirectionCone GetNormalCone(const GeometryContext & ctx) const;
+
     /// Get a bounding box for the geometry in object space
     virtual Bounds3f GetObjectBounds() const = 0;
 
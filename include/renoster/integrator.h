@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "renoster/filmaccumulator.h"
+#include "renoster/primitive.h"
 #include "renoster/ray.h"
 #include "renoster/sampler.h"
 #include "renoster/scene.h"
@@ -27,6 +28,18 @@ public:
                            FilmAccumulator * accum) const = 0;
 };
 
+/// Writes the AOVs of the surface hit by a camera ray
+inline void WriteSurfaceAovs(const Ray3f & ray, const ShadingPoint & sp,
+                             FilmAccumulator * accum)
+{
+    const Primitive * primitive = sp.instance ? sp.instance : sp.primitive;
+    accum->WriteAov(Aov::kDepth, Color(Distance(ray.o(), sp.p)));
+    accum->WriteAov(Aov::kNormal, Color(sp.ng.x(), sp.ng.y(), sp.ng.z()));
+    accum->WriteAov(Aov::kPosition, Color(sp.p.x(), sp.p.y(), sp.p.z()));
+    accum->WriteAov(Aov::kPrimitiveId,
+                    Color(static_cast<float>(primitive->GetPrimitiveId())));
+}
+
 RENO_API std::unique_ptr<Integrator> CreateIntegrator(const std::string & name,
                                                       ParameterList & params);
 
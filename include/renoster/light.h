@@ -5,15 +5,19 @@
 
 #include "renoster/color.h"
 #include "renoster/geometry.h"
+#include "renoster/lightbounds.h"
 #include "renoster/sampler.h"
 #include "renoster/shading.h"
 #include "renoster/transform.h"
 
 namespace renoster {
 
+/// LightContext holds the transforms of a light
 class RENO_API LightContext {
 public:
-    LightContext() = default;
+    LightContext()
+        : WorldToLight(IdentityTransform()),
+        LightToWorld(IdentityTransform()) {}
 
     LightContext(const Transform & WorldToLight,
                  const Transform & LightToWorld)
@@ -52,6 +56,13 @@ public:
     virtual Color EvaluateEmission(const LightContext & ctx,
                                    const ShadingPoint & sp,
                                    float * pdf) const = 0;
+
+    /// Bound the light in world space for the light BVH. Lights that can
+    /// not be bounded return false, they are picked uniformly.
+    virtual bool GetBounds(const LightContext & ctx,
+                           LightBounds * bounds) const {
+        return false;
+    }
 };
 
 /// A GeometryLight is a Light attached to some Geometry
@@ -0,0 +1,57 @@
+#ifndef RENOSTER_LIGHTBOUNDS_H_
+#define RENOSTER_LIGHTBOUNDS_H_
+
+#include "renoster/bounds.h"
+#include "renoster/export.h"
+#include "renoster/mathutil.h"
+#include "renoster/normal.h"
+#include "renoster/point.h"
+#include "renoster/vector.h"
+
+namespace renoster {
+
+/// DirectionCone bounds a set of directions by the angle to an axis
+struct DirectionCone {
+    DirectionCone() = default;
+
+    DirectionCone(const Vector3f & w, float cosTheta)
+        : w(Normalize(w)), cosTheta(cosTheta) {}
+
+    bool IsEmpty() const { return cosTheta == Infinity; }
+
+    static DirectionCone EntireSphere() {
+        return DirectionCone(Vector3f(0.f, 0.f, 1.f), -1.f);
+    }
+
+    Vector3f w = Vector3f(0.f, 0.f, 1.f);
+
+    /// Cosine of the largest angle to w, infinity for an empty cone
+    float cosTheta = Infinity;
+};
+
+/// Returns the smallest cone that contains both cones
+RENO_API DirectionCone Union(const DirectionCone & a, const DirectionCone & b);
+
+/// LightBounds bounds the positions, the power and the emitted directions
+/// of one or more lights. The lights emit from surfaces whose normals lie
+/// within the cone of angle thetaO around w, at most thetaE away from the
+/// normal (Conty Estevez and Kulla 2018).
+struct LightBounds {
+    Bounds3f bounds;
+    Vector3f w = Vector3f(0.f, 0.f, 1.f);
+    float phi = 0.f;
+    float cosThetaO = 1.f;
+    float cosThetaE = 1.f;
+    bool twoSided = false;
+
+    /// Returns a conservative estimate of the light reaching point p on a
+    /// surface with normal n. A zero normal is ignored.
+    RENO_API float Importance(const Point3f & p, const Normal3f & n) const;
+};
+
+/// Returns the bounds of both sets of lights
+RENO_API LightBounds Union(const LightBounds & a, const LightBounds & b);
+
+}  // namespace renoster
+
+#endif  // RENOSTER_LIGHTBOUNDS_H_
@@ -0,0 +1,70 @@
+#ifndef RENOSTER_LIGHTBVH_H_
+#define RENOSTER_LIGHTBVH_H_
+
+#include <vector>
+
+#include "renoster/export.h"
+#include "renoster/lightbounds.h"
+#include "renoster/primitive.h"
+#include "renoster/shading.h"
+#include "renoster/util/span.h"
+
+namespace renoster {
+
+/// LightBVH picks lights with a probability that estimates how much light
+/// they contribute to a shading point. It is a binary tree over the light
+/// bounds of the lights. Sampling descends from the root and picks each
+/// child by its importance for the shading point. Lights without bounds
+/// are picked uniformly.
+class RENO_API LightBVH {
+public:
+    LightBVH() = default;
+
+    /// Builds the tree in parallel. The index of a light in lights is its
+    /// light id.
+    explicit LightBVH(const std::vector<Primitive *> & lights);
+
+    /// Picks a light for ref and returns its id, or -1 if no light
+    /// reaches ref
+    int Sample(const ShadingPoint & ref, float u, float * pmf) const;
+
+    /// Returns the probability of Sample() picking a light for ref
+    float Pmf(const ShadingPoint & ref, int lightId) const;
+
+private:
+    struct Node {
+        LightBounds bounds;
+        int parent;
+
+        /// Second child of interior nodes, the first one follows the node.
+        /// Light id of leaves.
+        int index;
+        bool isLeaf;
+    };
+
+    struct BuildItem {
+        LightBounds bounds;
+        Point3f centroid;
+        int lightId;
+    };
+
+    void BuildRecursive(span<BuildItem> items, int nodeIndex, int parent);
+
+    /// Returns the probability of picking the tree over the unbounded lights
+    float GetTreeProbability() const;
+
+    /// A subtree over n lights takes 2n - 1 nodes, so the nodes of every
+    /// subtree are known before it is built
+    std::vector<Node> _nodes;
+
+    /// Leaf node of every light, or one of the values below
+    std::vector<int> _lightNodes;
+    std::vector<int> _unboundedLights;
+
+    static constexpr int UnboundedLight = -1;
+    static constexpr int ZeroPowerLight = -2;
+};
+
+}  // namespace renoster
+
+#endif  // RENOSTER_LIGHTBVH_H_
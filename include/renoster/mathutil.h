@@ -29,6 +29,16 @@ inline T Clamp(T value, T min, T max) {
     return std::min(std::max(value, min), max);
 };
 
+/// Square root that clamps negative rounding errors to zero
+inline float SafeSqrt(float x) {
+    return std::sqrt(std::max(0.f, x));
+}
+
+/// Arc cosine that clamps rounding errors outside [-1, 1]
+inline float SafeAcos(float x) {
+    return std::acos(Clamp(x, -1.f, 1.f));
+}
+
 inline bool SolveQuadratic(float a, float b, float c, float * t0, float * t1) {
     float discrim = b * b - 4.f * a * c;
 
@@ -0,0 +1,159 @@
+#ifndef RENOSTER_PARALLEL_H_
+#define RENOSTER_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "renoster/export.h"
+
+namespace renoster {
+
+/// Starts the worker threads of the task system. The calling thread counts
+/// as one of the numThreads threads, it executes tasks while waiting.
+RENO_API void ParallelInit(int numThreads);
+
+/// Stops the worker threads. No tasks may be pending.
+RENO_API void ParallelCleanup();
+
+/// Returns the number of threads of the task system, including the thread
+/// that called ParallelInit().
+RENO_API int NumThreads();
+
+/// Returns the index of the calling thread in [0, NumThreads()). Threads
+/// that are not part of the task system have index 0.
+RENO_API int ThreadIndex();
+
+/// TaskGroup tracks a set of spawned tasks. Tasks are pushed onto the deque
+/// of the spawning thread, idle threads steal them from the other end.
+class RENO_API TaskGroup {
+public:
+    TaskGroup() = default;
+
+    TaskGroup(const TaskGroup &) = delete;
+
+    TaskGroup & operator=(const TaskGroup &) = delete;
+
+    ~TaskGroup() { Wait(); }
+
+    void Spawn(std::function<void()> func);
+
+    /// Waits until all tasks of the group have finished. The calling thread
+    /// executes pending tasks in the meantime.
+    void Wait();
+
+private:
+    std::atomic<int> _numPending{0};
+
+    friend class TaskScheduler;
+};
+
+/// Calls func(begin, end) for disjoint ranges that together cover
+/// [begin, end). Ranges are split in half until they contain at most
+/// grainSize elements.
+RENO_API void ParallelFor(int64_t begin, int64_t end, int64_t grainSize,
+                          const std::function<void(int64_t, int64_t)> & func);
+
+/// Moves the elements of [begin, end) for which pred is true to the front
+/// and returns the first element of the second group. Like a serial
+/// two-ended partition, the k-th element from the left that fails pred is
+/// swapped with the k-th element from the right that passes it, so the
+/// result does not depend on the number of threads.
+template <typename T, typename Predicate>
+T * ParallelPartition(T * begin, T * end, const Predicate & pred,
+                      int64_t grainSize)
+{
+    int64_t size = end - begin;
+    if (size <= grainSize || NumThreads() == 1) {
+        while (true) {
+            while (begin != end && pred(*begin)) {
+                ++begin;
+            }
+            if (begin == end) {
+                return begin;
+            }
+            --end;
+            while (begin != end && !pred(*end)) {
+                --end;
+            }
+            if (begin == end) {
+                return begin;
+            }
+            std::swap(*begin, *end);
+            ++begin;
+        }
+    }
+
+    // Evaluate the predicate once for every element
+    int64_t numChunks = (size + grainSize - 1) / grainSize;
+    std::vector<uint8_t> flags(size);
+    std::vector<int64_t> chunkCounts(numChunks);
+    ParallelFor(0, numChunks, 1, [&](int64_t chunkBegin, int64_t chunkEnd) {
+        for (int64_t c = chunkBegin; c < chunkEnd; ++c) {
+            int64_t count = 0;
+            for (int64_t i = c * grainSize;
+                 i < std::min(size, (c + 1) * grainSize); ++i) {
+                flags[i] = pred(begin[i]);
+                count += flags[i];
+            }
+            chunkCounts[c] = count;
+        }
+    });
+
+    int64_t mid = 0;
+    for (int64_t count : chunkCounts) {
+        mid += count;
+    }
+
+    // Count the misplaced elements of every chunk, which are the failing
+    // elements before mid and the passing elements after it
+    ParallelFor(0, numChunks, 1, [&](int64_t chunkBegin, int64_t chunkEnd) {
+        for (int64_t c = chunkBegin; c < chunkEnd; ++c) {
+            int64_t count = 0;
+            for (int64_t i = c * grainSize;
+                 i < std::min(size, (c + 1) * grainSize); ++i) {
+                count += (i < mid) != static_cast<bool>(flags[i]);
+            }
+            chunkCounts[c] = count;
+        }
+    });
+
+    std::vector<int64_t> chunkOffsets(numChunks + 1, 0);
+    for (int64_t c = 0; c < numChunks; ++c) {
+        chunkOffsets[c + 1] = chunkOffsets[c] + chunkCounts[c];
+    }
+
+    // Gather the misplaced elements in order. Half of them lie before mid.
+    std::vector<int64_t> misplaced(chunkOffsets[numChunks]);
+    ParallelFor(0, numChunks, 1, [&](int64_t chunkBegin, int64_t chunkEnd) {
+        for (int64_t c = chunkBegin; c < chunkEnd; ++c) {
+            int64_t offset = chunkOffsets[c];
+            for (int64_t i = c * grainSize;
+                 i < std::min(size, (c + 1) * grainSize); ++i) {
+                if ((i < mid) != static_cast<bool>(flags[i])) {
+                    misplaced[offset++] = i;
+                }
+            }
+        }
+    });
+
+    // Swap the k-th misplaced element from the left with the k-th misplaced
+    // element from the right
+    int64_t numSwaps = static_cast<int64_t>(misplaced.size()) / 2;
+    ParallelFor(0, numSwaps, grainSize, [&](int64_t swapBegin,
+                                            int64_t swapEnd) {
+        for (int64_t k = swapBegin; k < swapEnd; ++k) {
+            std::swap(begin[misplaced[k]],
+                      begin[misplaced[misplaced.size() - 1 - k]]);
+        }
+    });
+
+    return begin + mid;
+}
+
+}  // namespace renoster
+
+#endif  // RENOSTER_PARALLEL_H_
@@ -1,6 +1,7 @@
 #ifndef RENOSTER_PRIMITIVE_H_
 #define RENOSTER_PRIMITIVE_H_
 
+#include <cstdint>
 #include <memory>
 
 #include "renoster/bounds.h"
@@ -14,12 +15,15 @@
 
 namespace renoster {
 
-///
+/// PrimitiveContext holds the transforms from the space of the primitive to
+/// world space. Primitives of the scene are in world space and get the
+/// identity, so do the primitives of an object, which are intersected in
+/// the space of the object.
 class PrimitiveContext {
 public:
     PrimitiveContext()
-        : WorldToPrimitive(Identity()),
-        PrimitiveToWorld(Identity()) {}
+        : WorldToPrimitive(IdentityTransform()),
+        PrimitiveToWorld(IdentityTransform()) {}
 
     PrimitiveContext(const Transform & WorldToPrimitive,
                      const Transform & PrimitiveToWorld)
@@ -81,12 +85,23 @@ public:
     /// Get the bounds of the primitive in world space
     virtual Bounds3f GetWorldBounds(const PrimitiveContext & ctx) const;
 
+    /// Bound the light of the primitive for the light BVH. Returns false
+    /// if the light can not be bounded.
+    virtual bool GetLightBounds(const PrimitiveContext & ctx,
+                                LightBounds * bounds) const;
+
     size_t GetLightId() const { return _lightId; }
 
-    size_t SetLightId(size_t lightId) { _lightId = lightId; }
+    void SetLightId(size_t lightId) { _lightId = lightId; }
+
+    /// Id written to the primitive id AOV, zero is the background
+    uint32_t GetPrimitiveId() const { return _primitiveId; }
+
+    void SetPrimitiveId(uint32_t primitiveId) { _primitiveId = primitiveId; }
 
 private:
     size_t _lightId = -1;
+    uint32_t _primitiveId = 0;
 };
 
 ///
@@ -131,12 +146,17 @@ public:
 
     Bounds3f GetWorldBounds(const PrimitiveContext & ctx) const;
 
+    bool GetLightBounds(const PrimitiveContext & ctx,
+                        LightBounds * bounds) const;
+
 private:
     std::shared_ptr<Geometry> _geometry;
     std::shared_ptr<GeometryLight> _light;
     std::shared_ptr<Material> _material;
-    Transform _WorldToGeometry;
-    Transform _GeometryToWorld;
+
+    // Contexts of the geometry and light in the space of the primitive
+    GeometryContext _geometryCtx;
+    LightContext _lightCtx;
 };
 
 ///
@@ -163,10 +183,12 @@ public:
                            const ShadingPoint & sp,
                            float * pdf) const;
 
+    bool GetLightBounds(const PrimitiveContext & ctx,
+                        LightBounds * bounds) const;
+
 private:
     std::shared_ptr<Light> _light;
-    Transform _WorldToLight;
-    Transform _LightToWorld;
+    LightContext _ctx;
 };
 
 ///
@@ -209,10 +231,12 @@ public:
 
     Bounds3f GetWorldBounds(const PrimitiveContext & ctx) const;
 
+    bool GetLightBounds(const PrimitiveContext & ctx,
+                        LightBounds * bounds) const;
+
 private:
     std::shared_ptr<Primitive> _primitive;
-    Transform _WorldToPrimitive;
-    Transform _PrimitiveToWorld;
+    PrimitiveContext _ctx;
 };
 
 }  // namespace renoster
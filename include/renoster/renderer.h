@@ -1,30 +1,63 @@
 #ifndef RENOSTER_RENDERER_H_
 #define RENOSTER_RENDERER_H_
 
+#include <string>
+
 #include "renoster/camera.h"
 #include "renoster/export.h"
 #include "renoster/film.h"
+#include "renoster/filmaccumulator.h"
 #include "renoster/integrator.h"
 #include "renoster/sampler.h"
 #include "renoster/scene.h"
+#include "renoster/util/allocator.h"
 
 namespace renoster {
 
+struct RenderSettings {
+    /// Samples per pixel of every pass over the film. The display is
+    /// updated after every pass. Zero renders all samples in a single pass.
+    int samplesPerPass = 0;
+
+    /// Seconds the passes may take, no pass is started that is not
+    /// expected to finish in time. Zero renders all passes.
+    float timeLimit = 0.f;
+
+    /// File the achieved samples per pixel and error are written to as
+    /// JSON, if not empty
+    std::string reportFilename;
+
+    /// File the film is checkpointed to between passes and when the render
+    /// stops, if not empty. Without samplesPerPass, the passes are sized
+    /// to end when the next checkpoint is due.
+    std::string checkpointFilename;
+
+    /// Seconds between checkpoints
+    float checkpointInterval = 60.f;
+
+    /// Continue the render from its checkpoint, if there is one
+    bool resume = false;
+};
+
 class RENO_API Renderer
 {
 public:
     Renderer(Camera * camera, Film * film, Integrator * integrator,
-             Sampler * sampler);
+             Sampler * sampler,
+             const RenderSettings & settings = RenderSettings());
 
     void Render(const Scene & scene);
 
 private:
-    void RenderThread(const Scene & scene, int threadId);
+    /// Renders the next tile of the film, returns false if there is none
+    bool RenderTile(const Scene & scene, int sampleBegin, int sampleEnd,
+                    FilmAccumulator & accum, Allocator & alloc);
 
     Camera * _camera;
     Film * _film;
     Integrator * _integrator;
     Sampler * _sampler;
+    RenderSettings _settings;
 };
 
 } // namespace renoster
@@ -24,6 +24,15 @@ RENO_API void RenoLookAt(float ex, float ey, float ez, float lx, float ly,
                          float lz, float ux, float uy, float uz);
 RENO_API void RenoObjectBegin(const std::string & handle);
 RENO_API void RenoObjectEnd();
+RENO_API void RenoObjectInstance(const std::string & handle);
+RENO_API void RenoOption(const std::string & name, ParameterList & params);
+
+/// Sets an option that takes precedence over RenoOption(), whenever that is
+/// called. Command line flags are passed this way, so they override the
+/// options of the scene file. The overrides apply until RenoEnd().
+RENO_API void RenoOptionOverride(const std::string & name,
+                                 ParameterList & params);
+
 RENO_API void RenoOrthographic(float zNear, float zFar);
 RENO_API void RenoMaterial(const std::string & name, ParameterList & params);
 RENO_API void RenoPerspective(float fov, float zNear, float zFar);
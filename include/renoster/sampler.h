@@ -10,29 +10,108 @@
 
 namespace renoster {
 
+/// Sampler generates the sample vectors of the pixels. A sample vector is
+/// a function of the pixel, the index of the sample in the pixel and the
+/// dimension alone, so any sample can be regenerated on any thread, no
+/// matter which tile or pass it belongs to. Renders split into passes take
+/// the same samples, their pixels are identical up to float summation
+/// order, since the film sums the samples of every pass separately.
+///
+/// The samplers generate the dimensions of a pixel sample in batches with
+/// a single virtual call, Get1D() and Get2D() read them from the batch.
 class RENO_API Sampler {
 public:
-    Sampler(int spp) : samplesPerPixel_(spp) {}
+    Sampler(int spp)
+        : samplesPerPixel_(spp), sampleBegin_(0), sampleEnd_(spp),
+        nextSample_(0), currentSample_(0), dimension_(0), batchBegin_(0),
+        batchEnd_(0) {}
 
-    virtual float Get1D() = 0;
+    virtual ~Sampler() = default;
 
-    virtual Point2f Get2D() = 0;
+    int GetSamplesPerPixel() const {
+        return samplesPerPixel_;
+    }
+
+    /// Restricts the samples taken in every pixel to [begin, end), for
+    /// rendering the samples in several passes
+    void SetSampleRange(int begin, int end) {
+        sampleBegin_ = begin;
+        sampleEnd_ = end;
+    }
+
+    float Get1D() {
+        return NextDimension()[0];
+    }
+
+    Point2f Get2D() {
+        const float * sample = NextDimension();
+        return Point2f(sample[0], sample[1]);
+    }
+
+    /// Fills samples with the dimensions [firstDimension, firstDimension +
+    /// numDimensions) of a pixel sample. Every dimension is a 2D point,
+    /// Get1D() takes its first coordinate.
+    virtual void GenerateSamples(const Point2i & pixel, int sampleIndex,
+                                 int firstDimension, int numDimensions,
+                                 float * samples) = 0;
 
-    virtual void StartPixel(const Point2i & pixel) {
+    /// Starts a sample of a pixel, at its first dimension
+    void StartPixelSample(const Point2i & pixel, int sampleIndex) {
         currentPixel_ = pixel;
-        currentSample_ = 0;
+        currentSample_ = sampleIndex;
+        dimension_ = 0;
+        batchBegin_ = 0;
+        batchEnd_ = 0;
     }
 
-    virtual bool StartNextSample() {
-        return currentSample_++ < samplesPerPixel_;
+    /// Starts the samples of the sample range of a pixel
+    void StartPixel(const Point2i & pixel) {
+        currentPixel_ = pixel;
+        nextSample_ = sampleBegin_;
+    }
+
+    bool StartNextSample() {
+        if (nextSample_ >= sampleEnd_) {
+            return false;
+        }
+        StartPixelSample(currentPixel_, nextSample_++);
+        return true;
     }
 
-    virtual std::unique_ptr<Sampler> Clone(int seed) = 0;
+    /// Returns a sampler for another thread, which generates the same
+    /// samples
+    virtual std::unique_ptr<Sampler> Clone() = 0;
 
 protected:
     int samplesPerPixel_;
+    int sampleBegin_;
+    int sampleEnd_;
+    int nextSample_;
     Point2i currentPixel_;
     int currentSample_;
+
+    /// Number of dimensions taken of the current sample
+    int dimension_;
+
+private:
+    /// Number of dimensions generated at once, one vector of points. The
+    /// integrators take a few dimensions per bounce, so larger batches
+    /// mostly generate dimensions that are never taken.
+    static constexpr int BatchSize = 4;
+
+    const float * NextDimension() {
+        if (dimension_ >= batchEnd_) {
+            batchBegin_ = dimension_;
+            batchEnd_ = dimension_ + BatchSize;
+            GenerateSamples(currentPixel_, currentSample_, batchBegin_,
+                            BatchSize, batch_);
+        }
+        return &batch_[2 * (dimension_++ - batchBegin_)];
+    }
+
+    int batchBegin_;
+    int batchEnd_;
+    float batch_[2 * BatchSize];
 };
 
 RENO_API std::unique_ptr<Sampler> CreateSampler(const std::string & name,
@@ -11,12 +11,27 @@
 
 namespace renoster {
 
+/// Distribution1D samples the indices of a piecewise constant function.
+/// Small distributions search the CDF, which maps u monotonically and
+/// keeps the stratification of the samples. Large ones use an alias table
+/// (Walker 1977, Vose 1991) instead, which samples in constant time.
+/// The bin of an alias table is picked with u[0], and the choice between
+/// the bin and its alias is taken from u[1]. A single u leaves too few
+/// fraction bits for that choice once the table is large.
 class RENO_API Distribution1D {
 public:
+    /// Smallest number of values sampled with an alias table
+    static constexpr size_t MinAliasTableSize = 256;
+
     Distribution1D() = default;
 
     Distribution1D(std::vector<float> func);
 
+    int SampleDiscrete(const Point2f & u, float * pdf,
+                       float * uRemapped) const;
+
+    /// Samples with a single u, whose fraction of u * n decides between an
+    /// alias and its bin. Only for distributions of a few thousand values.
     int SampleDiscrete(float u, float * pdf, float * uRemapped) const;
 
     float PdfDiscrete(int index) const;
@@ -33,7 +48,21 @@ public:
     float Integral() const { return _funcInt; }
 
 private:
+    /// Bin of the alias table. The bin keeps its own index with
+    /// probability q, and picks the alias otherwise.
+    struct AliasBin {
+        float q;
+        float pdf;
+        int alias;
+    };
+
+    void BuildAliasTable(const std::vector<float> & func);
+
+    int SampleAliasTable(int bin, float up, float * pdf,
+                         float * uRemapped) const;
+
     std::vector<float> _cdf;
+    std::vector<AliasBin> _aliasTable;
     float _funcInt;
 };
 
@@ -7,6 +7,7 @@
 #include "renoster/bvh.h"
 #include "renoster/camera.h"
 #include "renoster/export.h"
+#include "renoster/lightbvh.h"
 #include "renoster/primitive.h"
 #include "renoster/sampling.h"
 
@@ -37,6 +38,10 @@ private:
     std::unique_ptr<BVH> _bvh;
     std::vector<Primitive *> _lights;
 
+    /// Picks lights for SampleDirect() with respect to the shading point
+    LightBVH _lightBvh;
+
+    /// Picks lights uniformly for SampleEmission()
     Distribution1D _lightDistrib;
 };
 
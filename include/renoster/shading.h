@@ -52,6 +52,9 @@ public:
     const Primitive * primitive = nullptr;
     int face = 0;
 
+    // Instance of the hit object, if it belongs to an object definition
+    const Primitive * instance = nullptr;
+
     // Material
     BSDF * bsdf = nullptr;
 };
@@ -0,0 +1,76 @@
+#ifndef RENOSTER_STATS_H_
+#define RENOSTER_STATS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "renoster/export.h"
+
+namespace renoster {
+
+/// Stat lists the statistics that are collected when the library is built
+/// with RENOSTER_ENABLE_STATS. Counters are summed over the threads, the
+/// maxima are combined with std::max.
+enum class Stat {
+    // Counters
+    kCameraRays,
+    kIntersectRays,
+    kOccludedRays,
+    kNodeVisits,
+    kLeafVisits,
+    kPrimitiveTests,
+    kLeaves,
+    kLeafPrimitives,
+    kRussianRouletteKills,
+
+    // Maxima
+    kMaxLeafSize,
+    kAllocatorPeakBytes,
+
+    kNumStats
+};
+
+/// ThreadStats holds the statistics of a single thread, so collecting them
+/// needs neither locks nor atomics. They are merged by ReportStats().
+struct RENO_API ThreadStats {
+    ThreadStats();
+
+    ~ThreadStats();
+
+    uint64_t values[static_cast<int>(Stat::kNumStats)] = {};
+};
+
+/// Returns the statistics of the calling thread
+RENO_API ThreadStats & GetThreadStats();
+
+inline void StatAdd(Stat stat, uint64_t value)
+{
+    GetThreadStats().values[static_cast<int>(stat)] += value;
+}
+
+inline void StatMax(Stat stat, uint64_t value)
+{
+    uint64_t & cur = GetThreadStats().values[static_cast<int>(stat)];
+    cur = std::max(cur, value);
+}
+
+/// Merges the statistics of all threads and prints them as a table. The
+/// statistics are also written to jsonFilename, unless it is empty. No
+/// thread may collect statistics in the meantime.
+RENO_API void ReportStats(const std::string & jsonFilename);
+
+/// Clears the statistics of all threads
+RENO_API void ResetStats();
+
+}  // namespace renoster
+
+#ifdef RENOSTER_ENABLE_STATS
+#define RENO_STAT_ADD(stat, value) ::renoster::StatAdd(stat, value)
+#define RENO_STAT_MAX(stat, value) ::renoster::StatMax(stat, value)
+#else
+#define RENO_STAT_ADD(stat, value) do {} while (false)
+#define RENO_STAT_MAX(stat, value) do {} while (false)
+#endif
+
+#endif  // RENOSTER_STATS_H_
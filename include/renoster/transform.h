@@ -23,22 +23,56 @@ public:
     Transform(float mat[4][4]) {
         _mat = Matrix4x4f(mat);
         _matInv = Inverse(_mat);
+        UpdateFlags();
     }
 
-    Transform(const Matrix4x4f & mat) : _mat(mat), _matInv(Inverse(mat)) {}
+    Transform(const Matrix4x4f & mat) : _mat(mat), _matInv(Inverse(mat)) {
+        UpdateFlags();
+    }
 
     Transform(const Matrix4x4f & mat, const Matrix4x4f & matInv)
-        : _mat(mat), _matInv(matInv) {}
+        : _mat(mat), _matInv(matInv) {
+        UpdateFlags();
+    }
 
     const Matrix4x4f & GetMatrix() const { return _mat; }
 
     const Matrix4x4f & GetInverseMatrix() const { return _matInv; }
 
-    Point3f operator()(const Point3f & p) const { return _mat * p; }
+    /// Returns true if the transform does not change anything
+    bool IsIdentity() const { return _isIdentity; }
+
+    /// Returns true if the bottom row of the matrix is (0, 0, 0, 1), so
+    /// points can be transformed with the upper 3x4 part
+    bool IsAffine() const { return _isAffine; }
+
+    Point3f operator()(const Point3f & p) const {
+        if (_isIdentity) {
+            return p;
+        }
+        if (_isAffine) {
+            const Matrix4x4f & m = _mat;
+            return Point3f(
+                    m(0, 0) * p[0] + m(0, 1) * p[1] + m(0, 2) * p[2] + m(0, 3),
+                    m(1, 0) * p[0] + m(1, 1) * p[1] + m(1, 2) * p[2] + m(1, 3),
+                    m(2, 0) * p[0] + m(2, 1) * p[1] + m(2, 2) * p[2] + m(2, 3));
+        }
+        return _mat * p;
+    }
 
-    Vector3f operator()(const Vector3f & v) const { return _mat * v; }
+    Vector3f operator()(const Vector3f & v) const {
+        if (_isIdentity) {
+            return v;
+        }
+        return _mat * v;
+    }
 
-    Normal3f operator()(const Normal3f & n) const { return _matInv * n; }
+    Normal3f operator()(const Normal3f & n) const {
+        if (_isIdentity) {
+            return n;
+        }
+        return _matInv * n;
+    }
 
     Position3f operator()(const Position3f & pos) const {
         const Transform & T = *this;
@@ -47,6 +81,9 @@ public:
     }
 
     Ray3f operator()(const Ray3f & r) const {
+        if (_isIdentity) {
+            return r;
+        }
         const Transform & T = *this;
         Point3f o = T(r.o());
         Vector3f d = T(r.d());
@@ -54,6 +91,9 @@ public:
     }
 
     Bounds3f operator()(const Bounds3f & b) const {
+        if (_isIdentity) {
+            return b;
+        }
         const Transform & T = *this;
 
         Bounds3f ret(T(Point3f(b.min().x(), b.min().y(), b.min().z())));
@@ -85,13 +125,32 @@ public:
     }
 
     friend Transform operator*(const Transform & lhs, const Transform & rhs) {
+        if (lhs._isIdentity) {
+            return rhs;
+        }
+        if (rhs._isIdentity) {
+            return lhs;
+        }
         return Transform(lhs._mat * rhs._mat, rhs._matInv * lhs._matInv);
     }
 
     friend Transform Lerp(const Transform & t0, const Transform & t1, float t);
 
 private:
+    void UpdateFlags() {
+        _isAffine = _mat(3, 0) == 0.f && _mat(3, 1) == 0.f &&
+                    _mat(3, 2) == 0.f && _mat(3, 3) == 1.f;
+        _isIdentity = _isAffine;
+        for (size_t i = 0; i < 3; ++i) {
+            for (size_t j = 0; j < 4; ++j) {
+                _isIdentity &= _mat(i, j) == (i == j ? 1.f : 0.f);
+            }
+        }
+    }
+
     Matrix4x4f _mat, _matInv;
+    bool _isIdentity = false;
+    bool _isAffine = false;
 };
 
 inline Transform Lerp(const Transform & t0, const Transform & t1, float t) {
@@ -130,6 +189,10 @@ private:
 
 RENO_API Transform Identity();
 
+/// Returns a shared identity transform, which is cheaper to copy than to
+/// build with Identity()
+RENO_API const Transform & IdentityTransform();
+
 RENO_API Transform Translate(float dx, float dy, float dz);
 
 inline Transform Translate(const Vector3f & d) {
@@ -3,12 +3,16 @@
 #ifndef RENOSTER_UTIL_ALLOCATOR_H_
 #define RENOSTER_UTIL_ALLOCATOR_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <list>
 #include <memory>
 
 namespace renoster {
 
+/// Allocator hands out memory from a list of blocks that can all be reused
+/// at once. It is not thread-safe, so every thread should own its own.
 class Allocator {
 public:
     static constexpr size_t MaxAlignment = 256;
@@ -25,14 +29,24 @@ public:
 
     void Reset();
 
+    /// Frees all blocks, unlike Reset() which keeps them for reuse
+    void Release();
+
+    /// Returns the number of bytes of all blocks
+    size_t GetNumBytes() const;
+
 private:
     class Block {
     public:
         Block(size_t numBytes)
             : _bytesUsed(0), _numBytes(numBytes)
         {
+            // aligned_alloc requires the size to be a multiple of the alignment
+            size_t numBytesAligned = (numBytes + Allocator::MaxAlignment - 1)
+                                     & ~(Allocator::MaxAlignment - 1);
             _bytes = static_cast<uint8_t *>(
-                    std::aligned_alloc(Allocator::MaxAlignment, numBytes));
+                    std::aligned_alloc(Allocator::MaxAlignment,
+                                       numBytesAligned));
         }
 
         void * Alloc(size_t bytes, size_t alignment);
@@ -42,6 +56,11 @@ private:
             _bytesUsed = 0;
         }
 
+        size_t GetNumBytes() const
+        {
+            return _numBytes;
+        }
+
         void Free()
         {
             std::free(_bytes);
@@ -62,6 +81,11 @@ private:
 };
 
 inline Allocator::~Allocator()
+{
+    Release();
+}
+
+inline void Allocator::Release()
 {
     for (Block & block : _usedBlocks) {
         block.Free();
@@ -74,6 +98,18 @@ inline Allocator::~Allocator()
     _availableBlocks.clear();
 }
 
+inline size_t Allocator::GetNumBytes() const
+{
+    size_t numBytes = 0;
+    for (const Block & block : _usedBlocks) {
+        numBytes += block.GetNumBytes();
+    }
+    for (const Block & block : _availableBlocks) {
+        numBytes += block.GetNumBytes();
+    }
+    return numBytes;
+}
+
 inline void * Allocator::Block::Alloc(size_t numBytes, size_t alignment)
 {
     uintptr_t bytesPtr = reinterpret_cast<uintptr_t>(_bytes);
@@ -0,0 +1,121 @@
+#ifndef RENOSTER_UTIL_CURVE_H_
+#define RENOSTER_UTIL_CURVE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+namespace renoster {
+
+/// Spreads the lower 16 bits of x to the even bits of the result
+inline uint32_t SpreadBits(uint32_t x)
+{
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+/// Gathers the even bits of x to the lower 16 bits of the result
+inline uint32_t CompactBits(uint32_t x)
+{
+    x &= 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0f0f0f0f;
+    x = (x | (x >> 4)) & 0x00ff00ff;
+    x = (x | (x >> 8)) & 0x0000ffff;
+    return x;
+}
+
+/// Returns the Morton code of a point, x is stored in the even bits
+inline uint32_t EncodeMorton2(uint32_t x, uint32_t y)
+{
+    return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+inline void DecodeMorton2(uint32_t code, uint32_t * x, uint32_t * y)
+{
+    *x = CompactBits(code);
+    *y = CompactBits(code >> 1);
+}
+
+/// Returns the point at distance d along the Hilbert curve that fills an
+/// n x n grid, where n is a power of two
+inline void DecodeHilbert2(uint32_t n, uint32_t d, uint32_t * x, uint32_t * y)
+{
+    *x = 0;
+    *y = 0;
+    for (uint32_t s = 1; s < n; s *= 2) {
+        uint32_t rx = 1 & (d / 2);
+        uint32_t ry = 1 & (d ^ rx);
+
+        // Rotate the quadrant
+        if (ry == 0) {
+            if (rx == 1) {
+                *x = s - 1 - *x;
+                *y = s - 1 - *y;
+            }
+            std::swap(*x, *y);
+        }
+
+        *x += s * rx;
+        *y += s * ry;
+        d /= 4;
+    }
+}
+
+/// Returns the smallest power of two that is at least x
+inline uint32_t RoundUpPow2(uint32_t x)
+{
+    uint32_t n = 1;
+    while (n < x) {
+        n *= 2;
+    }
+    return n;
+}
+
+/// Returns the largest power of two that is at most x, x must not be zero
+inline uint32_t RoundDownPow2(uint32_t x)
+{
+    uint32_t n = 1;
+    while (n <= x / 2) {
+        n *= 2;
+    }
+    return n;
+}
+
+/// Calls visit(x, y) for every point of the w x h rectangle at (x0, y0).
+/// The rectangle is covered by the largest power of two squares that fit,
+/// each visited in Morton order, and the strips left at the right and the
+/// bottom are covered the same way. No point outside of the rectangle is
+/// visited, so thin rectangles cost no more than raster order.
+template <typename Visitor>
+void VisitMorton2(uint32_t x0, uint32_t y0, uint32_t w, uint32_t h,
+                  const Visitor & visit)
+{
+    if (w == 0 || h == 0) {
+        return;
+    }
+
+    uint32_t s = RoundDownPow2(std::min(w, h));
+    uint32_t blocksWidth = w / s * s;
+    uint32_t blocksHeight = h / s * s;
+    for (uint32_t by = 0; by < blocksHeight; by += s) {
+        for (uint32_t bx = 0; bx < blocksWidth; bx += s) {
+            for (uint32_t code = 0; code < s * s; ++code) {
+                uint32_t x, y;
+                DecodeMorton2(code, &x, &y);
+                visit(x0 + bx + x, y0 + by + y);
+            }
+        }
+    }
+
+    VisitMorton2(x0 + blocksWidth, y0, w - blocksWidth, blocksHeight, visit);
+    VisitMorton2(x0, y0 + blocksHeight, w, h - blocksHeight, visit);
+}
+
+}  // namespace renoster
+
+#endif  // RENOSTER_UTIL_CURVE_H_
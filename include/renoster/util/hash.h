@@ -0,0 +1,41 @@
+#ifndef RENOSTER_UTIL_HASH_H_
+#define RENOSTER_UTIL_HASH_H_
+
+#include <cstdint>
+
+namespace renoster {
+
+/// Mixes the bits of v, so every input bit affects every output bit. This
+/// is the finalizer of SplitMix64.
+inline uint64_t MixBits(uint64_t v)
+{
+    v ^= v >> 30;
+    v *= 0xbf58476d1ce4e5b9ULL;
+    v ^= v >> 27;
+    v *= 0x94d049bb133111ebULL;
+    v ^= v >> 31;
+    return v;
+}
+
+/// Combines a hash with another value
+inline uint64_t HashCombine(uint64_t hash, uint64_t v)
+{
+    return MixBits(hash ^ (v + 0x9e3779b97f4a7c15ULL + (hash << 6) +
+                           (hash >> 2)));
+}
+
+/// Hashes a list of integers
+inline uint64_t Hash(uint64_t v)
+{
+    return MixBits(v);
+}
+
+template <typename... Args>
+uint64_t Hash(uint64_t v, Args... args)
+{
+    return HashCombine(Hash(args...), v);
+}
+
+}  // namespace renoster
+
+#endif  // RENOSTER_UTIL_HASH_H_
@@ -0,0 +1,116 @@
+#ifndef RENOSTER_UTIL_VBOOL8_H_
+#define RENOSTER_UTIL_VBOOL8_H_
+
+#include <immintrin.h>
+
+// The 8-wide types are compiled for AVX2 function by function, so no
+// translation unit needs -mavx2. They may only be used by functions marked
+// RENO_TARGET_AVX2, which are only called on CPUs with AVX2.
+#if defined(__GNUC__)
+#define RENO_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RENO_TARGET_AVX2
+#endif
+
+namespace renoster {
+
+struct vbool8
+{
+    union
+    {
+        __m256 v;
+        int i[8];
+    };
+
+    RENO_TARGET_AVX2 vbool8()
+    {
+    }
+
+    RENO_TARGET_AVX2 vbool8(const vbool8 & b)
+        : v(b.v)
+    {
+    }
+
+    RENO_TARGET_AVX2 vbool8(const __m256 v)
+        : v(v)
+    {
+    }
+
+    RENO_TARGET_AVX2 vbool8(bool b)
+        : v(_mm256_castsi256_ps(_mm256_set1_epi32(b ? -1 : 0)))
+    {
+    }
+
+    RENO_TARGET_AVX2 operator const __m256 & () const
+    {
+        return v;
+    }
+
+    RENO_TARGET_AVX2 operator const __m256i() const
+    {
+        return _mm256_castps_si256(v);
+    }
+
+    RENO_TARGET_AVX2 vbool8 & operator=(const vbool8 & b)
+    {
+        v = b.v;
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vbool8 & operator&=(const vbool8 & b)
+    {
+        v = _mm256_and_ps(v, b.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vbool8 & operator|=(const vbool8 & b)
+    {
+        v = _mm256_or_ps(v, b.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vbool8 & operator^=(const vbool8 &b)
+    {
+        v = _mm256_xor_ps(v, b.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 bool operator[](size_t index) const
+    {
+        return i[index];
+    }
+};
+
+RENO_TARGET_AVX2
+inline vbool8 operator&(vbool8 lhs, const vbool8 & rhs)
+{
+    return lhs &= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator|(vbool8 lhs, const vbool8 & rhs)
+{
+    return lhs |= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator^(vbool8 lhs, const vbool8 & rhs)
+{
+    return lhs ^= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator!=(const vbool8 & lhs, const vbool8 & rhs)
+{
+    return _mm256_xor_ps(lhs, rhs);
+}
+
+RENO_TARGET_AVX2
+inline size_t MoveMask(const vbool8 & b)
+{
+    return _mm256_movemask_ps(b);
+}
+
+} // namespace renoster;
+
+#endif // RENOSTER_UTIL_VBOOL8_H_
@@ -25,6 +25,14 @@ struct vfloat4 {
     vfloat4(float x, float y, float z, float w)
         : v(_mm_set_ps(w, z, y, x)) {}
 
+    static vfloat4 LoadUnaligned(const float * ptr) {
+        return _mm_loadu_ps(ptr);
+    }
+
+    void StoreUnaligned(float * ptr) const {
+        _mm_storeu_ps(ptr, v);
+    }
+
     operator const __m128 & () const {
         return v;
     }
@@ -0,0 +1,142 @@
+#ifndef RENOSTER_UTIL_VFLOAT8_H_
+#define RENOSTER_UTIL_VFLOAT8_H_
+
+#include <immintrin.h>
+
+#include "renoster/util/vbool8.h"
+
+namespace renoster {
+
+struct vfloat8 {
+    union {
+        __m256 v;
+        float f[8];
+        int i[8];
+    };
+
+    RENO_TARGET_AVX2 vfloat8() {}
+     
+    RENO_TARGET_AVX2 constexpr vfloat8(const vfloat8 & f) : v(f.v) {}
+
+    RENO_TARGET_AVX2 constexpr vfloat8(const __m256 v) : v(v) {}
+
+    RENO_TARGET_AVX2 vfloat8(float x) : v(_mm256_set1_ps(x)) {}
+
+    RENO_TARGET_AVX2 vfloat8(float x0, float x1, float x2, float x3,
+                             float x4, float x5, float x6, float x7)
+        : v(_mm256_set_ps(x7, x6, x5, x4, x3, x2, x1, x0)) {}
+
+    RENO_TARGET_AVX2 static vfloat8 Load(const float * ptr) {
+        return _mm256_load_ps(ptr);
+    }
+
+    RENO_TARGET_AVX2 operator const __m256 & () const {
+        return v;
+    }
+
+    RENO_TARGET_AVX2 vfloat8 & operator=(const vfloat8 & f) {
+        v = f.v;
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vfloat8 operator-() const {
+        return _mm256_sub_ps(_mm256_setzero_ps(), v);
+    }
+
+    RENO_TARGET_AVX2 vfloat8 & operator+=(const vfloat8 & a) {
+        v = _mm256_add_ps(v, a.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vfloat8 & operator-=(const vfloat8 & a) {
+        v = _mm256_sub_ps(v, a.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vfloat8 & operator*=(const vfloat8 & a) {
+        v = _mm256_mul_ps(v, a.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 vfloat8 & operator/=(const vfloat8 & a) {
+        v = _mm256_div_ps(v, a.v);
+        return *this;
+    }
+
+    RENO_TARGET_AVX2 float operator[](size_t i) const {
+        return f[i];
+    }
+
+    RENO_TARGET_AVX2 float & operator[](size_t i) {
+        return f[i];
+    }
+};
+
+RENO_TARGET_AVX2
+inline vfloat8 operator+(vfloat8 lhs, const vfloat8 & rhs) {
+    return lhs += rhs;
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 operator-(vfloat8 lhs, const vfloat8 & rhs) {
+    return lhs -= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 operator*(vfloat8 lhs, const vfloat8 & rhs) {
+    return lhs *= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 operator/(vfloat8 lhs, const vfloat8 & rhs) {
+    return lhs /= rhs;
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator==(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_EQ_OQ);
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator!=(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_NEQ_UQ);
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator<(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_LT_OS);
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator>=(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_GE_OS);
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator>(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_GT_OS);
+}
+
+RENO_TARGET_AVX2
+inline vbool8 operator<=(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_cmp_ps(lhs, rhs, _CMP_LE_OS);
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 Max(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_max_ps(lhs, rhs);
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 Min(const vfloat8 & lhs, const vfloat8 & rhs) {
+    return _mm256_min_ps(lhs, rhs);
+}
+
+RENO_TARGET_AVX2
+inline vfloat8 Sqrt(const vfloat8 & f) {
+    return _mm256_sqrt_ps(f);
+}
+
+} // namespace renoster
+
+#endif // RENOSTER_UTIL_VFLOAT8_H_
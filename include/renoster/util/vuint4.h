@@ -0,0 +1,128 @@
+#ifndef RENOSTER_UTIL_VUINT4_H_
+#define RENOSTER_UTIL_VUINT4_H_
+
+#include <cstdint>
+
+#include <immintrin.h>
+
+#include "renoster/util/vfloat4.h"
+
+namespace renoster {
+
+/// Four unsigned 32 bit integers. Only SSE2 is required, so the
+/// multiplication is emulated with two 32x32->64 bit multiplications.
+struct vuint4 {
+    union {
+        __m128i v;
+        uint32_t u[4];
+    };
+
+    vuint4() {}
+
+    constexpr vuint4(const vuint4 & a) : v(a.v) {}
+
+    constexpr vuint4(const __m128i v) : v(v) {}
+
+    vuint4(uint32_t x) : v(_mm_set1_epi32(static_cast<int>(x))) {}
+
+    vuint4(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+        : v(_mm_set_epi32(static_cast<int>(w), static_cast<int>(z),
+                          static_cast<int>(y), static_cast<int>(x))) {}
+
+    operator const __m128i & () const {
+        return v;
+    }
+
+    vuint4 & operator=(const vuint4 & a) {
+        v = a.v;
+        return *this;
+    }
+
+    vuint4 & operator+=(const vuint4 & a) {
+        v = _mm_add_epi32(v, a.v);
+        return *this;
+    }
+
+    vuint4 & operator-=(const vuint4 & a) {
+        v = _mm_sub_epi32(v, a.v);
+        return *this;
+    }
+
+    vuint4 & operator*=(const vuint4 & a) {
+        __m128i even = _mm_mul_epu32(v, a.v);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(v, 32),
+                                    _mm_srli_epi64(a.v, 32));
+        v = _mm_unpacklo_epi32(
+                _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        return *this;
+    }
+
+    vuint4 & operator&=(const vuint4 & a) {
+        v = _mm_and_si128(v, a.v);
+        return *this;
+    }
+
+    vuint4 & operator|=(const vuint4 & a) {
+        v = _mm_or_si128(v, a.v);
+        return *this;
+    }
+
+    vuint4 & operator^=(const vuint4 & a) {
+        v = _mm_xor_si128(v, a.v);
+        return *this;
+    }
+
+    uint32_t operator[](size_t i) const {
+        return u[i];
+    }
+
+    uint32_t & operator[](size_t i) {
+        return u[i];
+    }
+};
+
+inline vuint4 operator+(vuint4 lhs, const vuint4 & rhs) {
+    return lhs += rhs;
+}
+
+inline vuint4 operator-(vuint4 lhs, const vuint4 & rhs) {
+    return lhs -= rhs;
+}
+
+inline vuint4 operator*(vuint4 lhs, const vuint4 & rhs) {
+    return lhs *= rhs;
+}
+
+inline vuint4 operator&(vuint4 lhs, const vuint4 & rhs) {
+    return lhs &= rhs;
+}
+
+inline vuint4 operator|(vuint4 lhs, const vuint4 & rhs) {
+    return lhs |= rhs;
+}
+
+inline vuint4 operator^(vuint4 lhs, const vuint4 & rhs) {
+    return lhs ^= rhs;
+}
+
+inline vuint4 operator<<(const vuint4 & a, int n) {
+    return _mm_slli_epi32(a, n);
+}
+
+inline vuint4 operator>>(const vuint4 & a, int n) {
+    return _mm_srli_epi32(a, n);
+}
+
+/// Converts to float with a single rounding, like the scalar conversion.
+/// SSE2 only converts signed integers, so the upper and lower halves are
+/// converted separately, the sum of both is exact before rounding.
+inline vfloat4 ConvertToFloat(const vuint4 & a) {
+    __m128 hi = _mm_cvtepi32_ps(_mm_srli_epi32(a, 16));
+    __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(a, _mm_set1_epi32(0xffff)));
+    return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.f)), lo);
+}
+
+} // namespace renoster
+
+#endif // RENOSTER_UTIL_VUINT4_H_
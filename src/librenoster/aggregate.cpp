@@ -0,0 +1,51 @@
+#include "renoster/aggregate.h"
+
+#include "renoster/accel/builder.h"
+#include "renoster/accel/splitter.h"
+
+namespace renoster {
+
+Aggregate::Aggregate(std::vector<std::shared_ptr<Primitive>> primitives)
+    : _primitives(std::move(primitives))
+{
+    std::vector<Primitive *> prims;
+    prims.reserve(_primitives.size());
+    for (const auto & primitive : _primitives) {
+        prims.push_back(primitive.get());
+    }
+
+    // Build a BVH over the primitives in object space
+    _bvh = std::make_unique<BVH>();
+    ObjectSplitter splitter;
+    size_t minLeafSize = 1;
+    BVHBuilder<Primitive, ObjectSplitter> builder(
+            _bvh.get(), splitter, minLeafSize, BVH::NativeWidth());
+    PrimitiveContext pCtx;
+    builder.Build(pCtx, prims);
+
+    for (Primitive * prim : prims) {
+        _bounds = Union(_bounds, prim->GetWorldBounds(pCtx));
+    }
+}
+
+bool Aggregate::Intersect(const PrimitiveContext & ctx, const Ray3f & ray,
+                          ShadingPoint * sp) const
+{
+    // The primitives compose their transforms with the context themselves,
+    // only the traversal needs the ray in object space
+    Ray3f objRay = ctx.WorldToPrimitive(ray);
+    return _bvh->Intersect<Primitive>(ctx, objRay, ray, sp);
+}
+
+bool Aggregate::Occluded(const PrimitiveContext & ctx, const Ray3f & ray) const
+{
+    Ray3f objRay = ctx.WorldToPrimitive(ray);
+    return _bvh->Occluded<Primitive>(ctx, objRay, ray);
+}
+
+Bounds3f Aggregate::GetWorldBounds(const PrimitiveContext & ctx) const
+{
+    return ctx.PrimitiveToWorld(_bounds);
+}
+
+}  // namespace renoster
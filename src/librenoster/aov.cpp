@@ -0,0 +1,42 @@
+#include "renoster/aov.h"
+
+namespace renoster {
+
+namespace {
+
+const AovInfo aovInfos[] = {
+    {Aov::kColor, AovFilter::kAverage, "color", 3, {"R", "G", "B"}},
+    {Aov::kDepth, AovFilter::kMin, "depth", 1, {"Z"}},
+    {Aov::kNormal, AovFilter::kAverage, "normal", 3,
+     {"N.X", "N.Y", "N.Z"}},
+    {Aov::kAlbedo, AovFilter::kAverage, "albedo", 3,
+     {"albedo.R", "albedo.G", "albedo.B"}},
+    {Aov::kPosition, AovFilter::kAverage, "position", 3,
+     {"P.X", "P.Y", "P.Z"}},
+    {Aov::kPrimitiveId, AovFilter::kClosest, "primid", 1, {"id"}},
+    {Aov::kSampleCount, AovFilter::kCount, "samplecount", 1,
+     {"samplecount"}}
+};
+
+static_assert(sizeof(aovInfos) / sizeof(aovInfos[0]) == NumAovs,
+              "every Aov needs an AovInfo");
+
+}  // anonymous namespace
+
+const AovInfo & GetAovInfo(Aov aov)
+{
+    return aovInfos[static_cast<int>(aov)];
+}
+
+bool FindAov(const std::string & name, Aov * aov)
+{
+    for (const AovInfo & info : aovInfos) {
+        if (name == info.name) {
+            *aov = info.aov;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace renoster
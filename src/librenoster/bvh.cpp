@@ -1,6 +1,8 @@
 #include "renoster/bvh.h"
 
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 #include "renoster/log.h"
 #include "renoster/mathutil.h"
@@ -14,6 +16,12 @@ inline size_t CountTrailingZeros(size_t mask) { return __builtin_ctz(mask); }
 
 } // anonymous namespace
 
+size_t BVH::NativeWidth()
+{
+    static const size_t width = __builtin_cpu_supports("avx2") ? 8 : 4;
+    return width;
+}
+
 void TraverseNode(const BVH::BaseNode * node, vfloat4 vdist, vbool4 vmask,
                   BVH::NodeRef *& stackPtr)
 {
@@ -88,6 +96,35 @@ void TraverseNode(const BVH::BaseNode * node, vfloat4 vdist, vbool4 vmask,
     *(stackPtr++) = c0;
 }
 
+void TraverseQuantizedNode(const BVH::QuantizedNode & node, vfloat4 vdist,
+                           vbool4 vmask, uint32_t *& stackPtr)
+{
+    size_t mask = MoveMask(vmask);
+
+    // Push the children from far to near, so the nearest is popped first
+    uint32_t * first = stackPtr;
+    float dists[4];
+    while (mask != 0) {
+        size_t i = CountTrailingZeros(mask);
+        mask &= mask - 1;
+        if (node.children[i] == BVH::QuantizedNode::Empty) {
+            continue;
+        }
+
+        // Insertion sort on decreasing distance
+        float dist = vdist[i];
+        size_t j = stackPtr - first;
+        while (j > 0 && dists[j - 1] < dist) {
+            dists[j] = dists[j - 1];
+            first[j] = first[j - 1];
+            --j;
+        }
+        dists[j] = dist;
+        first[j] = node.children[i];
+        ++stackPtr;
+    }
+}
+
 void TraverseNodeOccluded(const BVH::BaseNode * node, vfloat4 vdist,
                           vbool4 vmask, BVH::NodeRef *& stackPtr)
 {
@@ -176,6 +213,82 @@ vbool4 BVH::AlignedNode::Intersect(const TraversalRay & ray,
     return IntersectBounds(ray, bounds, dist);
 }
 
+BVH::QuantizedNode::QuantizedNode(const AlignedNode & node)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        children[i] = Empty;
+    }
+
+    // The quantization grid spans the union of the children
+    Bounds3f bounds;
+    for (size_t i = 0; i < 4; ++i) {
+        if (node.children[i].GetBaseNode()) {
+            bounds.ExpandBy(Bounds3f(
+                    Point3f(node.bounds.min().x()[i], node.bounds.min().y()[i],
+                            node.bounds.min().z()[i]),
+                    Point3f(node.bounds.max().x()[i], node.bounds.max().y()[i],
+                            node.bounds.max().z()[i])));
+        }
+    }
+
+    for (size_t d = 0; d < 3; ++d) {
+        origin[d] = bounds.min()[d];
+        scale[d] = (bounds.max()[d] - bounds.min()[d]) / 255.f;
+        while (origin[d] + 255.f * scale[d] < bounds.max()[d]) {
+            scale[d] = std::nextafter(scale[d],
+                                      std::numeric_limits<float>::max());
+        }
+
+        for (size_t i = 0; i < 4; ++i) {
+            // Empty slots decode to inverted bounds
+            if (!node.children[i].GetBaseNode()) {
+                lower[d][i] = 255;
+                upper[d][i] = 0;
+                continue;
+            }
+
+            // Round outwards and correct for the rounding of the decoding,
+            // which computes origin + q * scale in single precision
+            float lo = node.bounds.min()[d][i];
+            float hi = node.bounds.max()[d][i];
+            int qLo = 0;
+            int qHi = 0;
+            if (scale[d] > 0.f) {
+                qLo = Clamp(static_cast<int>(
+                        std::floor((lo - origin[d]) / scale[d])), 0, 255);
+                qHi = Clamp(static_cast<int>(
+                        std::ceil((hi - origin[d]) / scale[d])), 0, 255);
+            }
+            while (qLo > 0 && origin[d] + qLo * scale[d] > lo) {
+                --qLo;
+            }
+            while (qHi < 255 && origin[d] + qHi * scale[d] < hi) {
+                ++qHi;
+            }
+            lower[d][i] = static_cast<uint8_t>(qLo);
+            upper[d][i] = static_cast<uint8_t>(qHi);
+        }
+    }
+}
+
+vbool4 BVH::QuantizedNode::Intersect(const TraversalRay & ray,
+                                     vfloat4 & dist) const
+{
+    // Decode the child bounds
+    Point3vf4 pMin;
+    Point3vf4 pMax;
+    for (size_t d = 0; d < 3; ++d) {
+        vfloat4 vorigin(origin[d]);
+        vfloat4 vscale(scale[d]);
+        pMin[d] = vorigin + vfloat4(lower[d][0], lower[d][1], lower[d][2],
+                                    lower[d][3]) * vscale;
+        pMax[d] = vorigin + vfloat4(upper[d][0], upper[d][1], upper[d][2],
+                                    upper[d][3]) * vscale;
+    }
+
+    return IntersectBounds(ray, Bounds3v4f(pMin, pMax), dist);
+}
+
 vbool4 BVH::AlignedNodeMB::Intersect(const TraversalRay & ray,
                                      vfloat4 & dist) const
 {
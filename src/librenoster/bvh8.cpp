@@ -0,0 +1,101 @@
+// Only the 8-wide kernels of this file are compiled for AVX2, with
+// RENO_TARGET_AVX2. They may only be called for AlignedNode8 nodes, which
+// are only built when the CPU supports AVX2. The file itself is compiled
+// without -mavx2, so out-of-line copies of the shared headers emitted here
+// stay safe to run on any CPU.
+
+#include "renoster/bvh.h"
+
+#include "renoster/util/vbool8.h"
+#include "renoster/util/vfloat8.h"
+
+namespace renoster {
+
+namespace {
+
+inline size_t CountTrailingZeros(size_t mask) { return __builtin_ctz(mask); }
+
+RENO_TARGET_AVX2
+vbool8 IntersectBounds8(const BVH::AlignedNode8 * node,
+                        const TraversalRay & ray, vfloat8 & dist)
+{
+    const float * const bounds[2][3] = {
+        {node->lower[0], node->lower[1], node->lower[2]},
+        {node->upper[0], node->upper[1], node->upper[2]}
+    };
+
+    vfloat8 orgX(ray.org.x()[0]);
+    vfloat8 orgY(ray.org.y()[0]);
+    vfloat8 orgZ(ray.org.z()[0]);
+    vfloat8 invDirX(ray.invDir.x()[0]);
+    vfloat8 invDirY(ray.invDir.y()[0]);
+    vfloat8 invDirZ(ray.invDir.z()[0]);
+
+    vfloat8 pMinX = vfloat8::Load(bounds[ray.neg[0]][0]);
+    vfloat8 pMinY = vfloat8::Load(bounds[ray.neg[1]][1]);
+    vfloat8 pMinZ = vfloat8::Load(bounds[ray.neg[2]][2]);
+    vfloat8 tMinX = (pMinX - orgX) * invDirX;
+    vfloat8 tMinY = (pMinY - orgY) * invDirY;
+    vfloat8 tMinZ = (pMinZ - orgZ) * invDirZ;
+
+    vfloat8 pMaxX = vfloat8::Load(bounds[1 - ray.neg[0]][0]);
+    vfloat8 pMaxY = vfloat8::Load(bounds[1 - ray.neg[1]][1]);
+    vfloat8 pMaxZ = vfloat8::Load(bounds[1 - ray.neg[2]][2]);
+    vfloat8 tMaxX = (pMaxX - orgX) * invDirX;
+    vfloat8 tMaxY = (pMaxY - orgY) * invDirY;
+    vfloat8 tMaxZ = (pMaxZ - orgZ) * invDirZ;
+
+    vfloat8 tMin = Max(Max(tMinX, tMinY), Max(tMinZ, vfloat8(ray.tMin[0])));
+    vfloat8 tMax = Min(Min(tMaxX, tMaxY), Min(tMaxZ, vfloat8(ray.tMax[0])));
+
+    dist = tMin;
+
+    return tMin <= tMax;
+}
+
+} // anonymous namespace
+
+RENO_TARGET_AVX2
+void TraverseNode8(const BVH::AlignedNode8 * node, const TraversalRay & ray,
+                   BVH::NodeRef *& stackPtr)
+{
+    vfloat8 vdist;
+    size_t mask = MoveMask(IntersectBounds8(node, ray, vdist));
+
+    // Push the children from far to near, so the nearest is popped first
+    BVH::NodeRef * first = stackPtr;
+    float dists[8];
+    while (mask != 0) {
+        size_t i = CountTrailingZeros(mask);
+        mask &= mask - 1;
+
+        // Insertion sort on decreasing distance
+        float dist = vdist[i];
+        size_t j = stackPtr - first;
+        while (j > 0 && dists[j - 1] < dist) {
+            dists[j] = dists[j - 1];
+            first[j] = first[j - 1];
+            --j;
+        }
+        dists[j] = dist;
+        first[j] = node->children[i];
+        ++stackPtr;
+    }
+}
+
+RENO_TARGET_AVX2
+void TraverseNode8Occluded(const BVH::AlignedNode8 * node,
+                           const TraversalRay & ray,
+                           BVH::NodeRef *& stackPtr)
+{
+    vfloat8 vdist;
+    size_t mask = MoveMask(IntersectBounds8(node, ray, vdist));
+
+    while (mask != 0) {
+        size_t i = CountTrailingZeros(mask);
+        mask &= mask - 1;
+        *(stackPtr++) = node->children[i];
+    }
+}
+
+}  // namespace renoster
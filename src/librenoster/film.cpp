@@ -1,30 +1,342 @@
 #include "renoster/film.h"
 
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <utility>
 
 #include "renoster/bounds.h"
 #include "renoster/display.h"
 #include "renoster/log.h"
+#include "renoster/parallel.h"
 #include "renoster/pixelfilter.h"
 #include "renoster/point.h"
 #include "renoster/sampler.h"
+#include "renoster/util/curve.h"
+#include "renoster/util/vfloat4.h"
 
 namespace renoster {
 
+namespace {
+
+/// Adds to a film pixel that other tiles may update at the same time
+void AtomicAdd(std::atomic<float> & value, float delta)
+{
+    if (delta == 0.f) {
+        return;
+    }
+    float cur = value.load(std::memory_order_relaxed);
+    while (!value.compare_exchange_weak(cur, cur + delta,
+                                        std::memory_order_relaxed)) {
+    }
+}
+
+void AtomicAdd(std::atomic<int> & value, int delta)
+{
+    if (delta != 0) {
+        value.fetch_add(delta, std::memory_order_relaxed);
+    }
+}
+
+/// Adds to a film pixel that only the calling tile updates
+template <typename T>
+void ExclusiveAdd(std::atomic<T> & value, T delta)
+{
+    value.store(value.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+/// Planes of the sums of a film tile. The AOV sums follow.
+constexpr int ContribSum = 0;
+constexpr int WeightSum = 3;
+constexpr int LuminanceSqSum = 4;
+constexpr int WeightSqSum = 5;
+constexpr int NumPixelSums = 6;
+constexpr int MaxTileSums = NumPixelSums + 3 * NumAovs;
+
+/// Adds value * weights[i] to row[i] for the n pixels of a row. The
+/// vectors reach up to three floats past the row, the lanes there are
+/// masked with lastMask and add nothing.
+void SplatRow(float * row, const float * weights, float value, int n,
+              __m128 lastMask)
+{
+    const vfloat4 v(value);
+    for (int i = 0; i < n; i += 4) {
+        vfloat4 add = vfloat4::LoadUnaligned(weights + i) * v;
+        if (i + 4 > n) {
+            add = _mm_and_ps(lastMask, add);
+        }
+        vfloat4 sum = vfloat4::LoadUnaligned(row + i) + add;
+        sum.StoreUnaligned(row + i);
+    }
+}
+
+/// Adds weights[i]^2 to row[i] for the n pixels of a row
+void SplatRowSquared(float * row, const float * weights, int n,
+                     __m128 lastMask)
+{
+    for (int i = 0; i < n; i += 4) {
+        vfloat4 w = vfloat4::LoadUnaligned(weights + i);
+        vfloat4 add = w * w;
+        if (i + 4 > n) {
+            add = _mm_and_ps(lastMask, add);
+        }
+        vfloat4 sum = vfloat4::LoadUnaligned(row + i) + add;
+        sum.StoreUnaligned(row + i);
+    }
+}
+
+/// Key of a pixel without samples
+constexpr uint64_t EmptyAovKey = UINT64_MAX;
+
+/// Returns the key of a sample of an AOV taking the value of the closest
+/// sample. Non-negative floats order like their bits, so the smallest key
+/// holds the value of the sample with the smallest depth.
+uint64_t MakeAovKey(float depth, float value)
+{
+    uint32_t depthBits, valueBits;
+    std::memcpy(&depthBits, &depth, sizeof(float));
+    std::memcpy(&valueBits, &value, sizeof(float));
+    return (static_cast<uint64_t>(depthBits) << 32) | valueBits;
+}
+
+float GetAovKeyValue(uint64_t key)
+{
+    uint32_t valueBits = static_cast<uint32_t>(key);
+    float value;
+    std::memcpy(&value, &valueBits, sizeof(float));
+    return value;
+}
+
+/// Lowers a key that other tiles may update at the same time
+void AtomicMin(std::atomic<uint64_t> & value, uint64_t key)
+{
+    uint64_t cur = value.load(std::memory_order_relaxed);
+    while (key < cur && !value.compare_exchange_weak(
+                            cur, key, std::memory_order_relaxed)) {
+    }
+}
+
+/// Lowers a key that only the calling tile updates
+void ExclusiveMin(std::atomic<uint64_t> & value, uint64_t key)
+{
+    if (key < value.load(std::memory_order_relaxed)) {
+        value.store(key, std::memory_order_relaxed);
+    }
+}
+
+void ClearPixel(FilmPixel & pixel)
+{
+    for (int c = 0; c < 3; ++c) {
+        pixel.contribSum[c].store(0.f, std::memory_order_relaxed);
+    }
+    pixel.weightSum.store(0.f, std::memory_order_relaxed);
+    pixel.luminanceSqSum.store(0.f, std::memory_order_relaxed);
+    pixel.weightSqSum.store(0.f, std::memory_order_relaxed);
+    pixel.sampleCount.store(0, std::memory_order_relaxed);
+}
+
+/// Returns the final color of a pixel
+Color ResolvePixel(const FilmPixel & pixel)
+{
+    Color color(pixel.contribSum[0].load(std::memory_order_relaxed),
+                pixel.contribSum[1].load(std::memory_order_relaxed),
+                pixel.contribSum[2].load(std::memory_order_relaxed));
+    float weightSum = pixel.weightSum.load(std::memory_order_relaxed);
+    if (weightSum != 0.f) {
+        color /= weightSum;
+    }
+    return color;
+}
+
+/// Estimates the standard error of the luminance of a pixel, relative to
+/// the square root of the luminance, so dark pixels do not need as many
+/// samples as bright ones. Returns false if the pixel has too few samples.
+bool EstimatePixelError(const FilmPixel & pixel, float * error)
+{
+    float weightSum = pixel.weightSum.load(std::memory_order_relaxed);
+    float weightSqSum = pixel.weightSqSum.load(std::memory_order_relaxed);
+    if (weightSum <= 0.f || weightSqSum <= 0.f) {
+        return false;
+    }
+
+    // The weighted mean has the variance of this many unweighted samples
+    float numEffective = weightSum * weightSum / weightSqSum;
+    if (numEffective <= 1.f) {
+        return false;
+    }
+
+    Color contrib(pixel.contribSum[0].load(std::memory_order_relaxed),
+                  pixel.contribSum[1].load(std::memory_order_relaxed),
+                  pixel.contribSum[2].load(std::memory_order_relaxed));
+    float mean = contrib.Luminance() / weightSum;
+    float meanSq = pixel.luminanceSqSum.load(std::memory_order_relaxed) /
+                   weightSum;
+    float variance = std::max(0.f, meanSq - mean * mean) /
+                     (numEffective - 1.f);
+
+    *error = std::sqrt(variance) / std::sqrt(std::max(mean, 0.f) + 1e-3f);
+    return true;
+}
+
+/// Header of a checkpoint file. It is followed by the pixels in scanlines,
+/// the converged flags of the pixels, if there are any, and the sums and
+/// keys of the AOVs.
+struct CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t pixelBounds[4];
+    CheckpointProgress progress;
+    uint32_t hasConverged;
+    int32_t numAovSums;
+    int32_t numAovKeys;
+};
+
+/// Pixel as stored in a checkpoint
+struct CheckpointPixel {
+    float contribSum[3];
+    float weightSum;
+    float luminanceSqSum;
+    float weightSqSum;
+    int32_t sampleCount;
+};
+
+constexpr char CheckpointMagic[4] = {'R', 'N', 'C', 'K'};
+constexpr uint32_t CheckpointVersion = 3;
+
+/// Number of rows resolved by a single task
+constexpr int64_t ResolveGrainSize = 16;
+
+}  // anonymous namespace
+
+/// DisplayTileWriter writes tiles to a display on a background thread, so
+/// the render threads do not wait for the display
+class DisplayTileWriter {
+public:
+    explicit DisplayTileWriter(Display * display)
+        : _display(display), _thread([this]() { Run(); }) {}
+
+    ~DisplayTileWriter() { Finish(); }
+
+    void Push(const Bounds2i & bounds, std::vector<float> pixels)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tiles.emplace_back(bounds, std::move(pixels));
+        }
+        _cond.notify_one();
+    }
+
+    /// Writes the pending tiles and stops the thread
+    void Finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _cond.notify_one();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [this]() { return _done || !_tiles.empty(); });
+            if (_tiles.empty()) {
+                return;
+            }
+            std::pair<Bounds2i, std::vector<float>> tile =
+                    std::move(_tiles.front());
+            _tiles.pop_front();
+
+            lock.unlock();
+            if (!_display->WriteTile(tile.first, tile.second.data())) {
+                Error("Could not write tile to display: %s",
+                      _display->GetError());
+            }
+            lock.lock();
+        }
+    }
+
+    Display * _display;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::pair<Bounds2i, std::vector<float>>> _tiles;
+    bool _done = false;
+    std::thread _thread;
+};
+
+AovLayout::AovLayout(const std::vector<Aov> & aovs)
+    : aovs(aovs)
+{
+    if (this->aovs.empty()) {
+        this->aovs.push_back(Aov::kColor);
+    }
+
+    for (Aov aov : this->aovs) {
+        const AovInfo & info = GetAovInfo(aov);
+        for (int c = 0; c < info.numChannels; ++c) {
+            channelNames.push_back(info.channelNames[c]);
+        }
+
+        // The color and the sample count are stored in the pixels
+        int & offset = offsets[static_cast<int>(aov)];
+        if (aov == Aov::kColor || info.filter == AovFilter::kCount) {
+            continue;
+        }
+        if (info.filter == AovFilter::kAverage) {
+            sumAovs.push_back(aov);
+            offset = numSums;
+            numSums += info.numChannels;
+        } else {
+            keyAovs.push_back(aov);
+            offset = numKeys;
+            ++numKeys;
+        }
+    }
+}
+
 FilmTile::FilmTile(int tileId, const Point2i & index,
                    const Bounds2i & pixelBounds, const Bounds2i & sampleBounds,
                    const PixelFilter * filter, const FilterTable * filterTable,
-                   FilmSampleMode sampleMode)
+                   FilmSampleMode sampleMode, const AovLayout * aovLayout)
     : _tileId(tileId),
     _index(index),
     _pixelBounds(pixelBounds),
     _sampleBounds(sampleBounds),
     _filter(filter),
     _filterTable(filterTable),
-    _sampleMode(sampleMode)
+    _sampleMode(sampleMode),
+    _aovLayout(aovLayout)
 {
-    _pixels.resize(std::max(0, _pixelBounds.Volume()));
+    // The planes are padded for the vectors of the last row
+    _numPixels = std::max(0, _pixelBounds.Volume());
+    _planeSize = _numPixels + 3;
+    _sums.resize(static_cast<size_t>(NumPixelSums + _aovLayout->numSums) *
+                 _planeSize, 0.f);
+    _sampleCounts.resize(_numPixels, 0);
+    _aovKeys.resize(static_cast<size_t>(_aovLayout->numKeys) * _numPixels,
+                    EmptyAovKey);
+
+    // A sample reaches at most this many pixels in each direction. The
+    // rows are rounded up to whole vectors.
+    if (_sampleMode == FilmSampleMode::kConvolution) {
+        _filterRadius = _filter->GetRadius();
+        int maxWidth = static_cast<int>(std::ceil(2.f * _filterRadius.x()));
+        int maxHeight = static_cast<int>(std::ceil(2.f * _filterRadius.y()));
+        _weights.resize(((maxWidth + 4) & ~3) * (maxHeight + 1));
+    }
 }
 
 Point2f FilmTile::Sample(const Point2i & pixel, Sampler * sampler,
@@ -57,80 +369,225 @@ void FilmTile::AddSample(const Point2i & pPixel, const Point2f & pSample,
 {
     Color L;
     accum.GetValue(L);
+    float luminance = L.Luminance();
+
+    // Values added to the sums, weighted by the filter. Samples placed by
+    // importance sampling the filter have weight 1.
+    int numSums = NumPixelSums + _aovLayout->numSums;
+    float values[MaxTileSums];
+    values[ContribSum] = L.r();
+    values[ContribSum + 1] = L.g();
+    values[ContribSum + 2] = L.b();
+    values[WeightSum] = 1.f;
+    values[LuminanceSqSum] = luminance * luminance;
+    values[WeightSqSum] = 1.f;
+
+    // AOVs the integrator did not write are 0
+    for (Aov aov : _aovLayout->sumAovs) {
+        const AovInfo & info = GetAovInfo(aov);
+        Color value;
+        if (!accum.GetAov(aov, value)) {
+            value = Color(0.f);
+        }
+        int first = NumPixelSums + _aovLayout->offsets[static_cast<int>(aov)];
+        for (int c = 0; c < info.numChannels; ++c) {
+            values[first + c] = value[c];
+        }
+    }
 
     if (_sampleMode == FilmSampleMode::kConvolution) {
-        Vector2f filterRadius = _filter->GetRadius();
-        Point2i pMin = Point2i(Ceil(pPixel + filterRadius));
-        Point2i pMax = Point2i(Floor(pPixel + filterRadius)) + Point2i(1);
+        // The pixels whose centres are within the filter radius
+        Vector2f halfPixel(0.5f);
+        Point2i pMin = Point2i(Ceil(pSample - halfPixel - _filterRadius));
+        Point2i pMax = Point2i(Floor(pSample - halfPixel + _filterRadius)) +
+                       Point2i(1);
 
         Bounds2i bPixels = Bounds2i(pMin, pMax);
         bPixels = Intersection(bPixels, _pixelBounds);
-        for (Point2i p : bPixels) {
-            Point2f pFilter(p.x() + 0.5f - pSample.x(),
-                            p.y() + 0.5f - pSample.y());
-            float weight = _filterTable->Evaluate(pFilter);
+        if (!bPixels.IsDegenerate()) {
+            // Evaluate the weights of the footprint for whole vectors in
+            // every row. The lanes past the row are masked.
+            int width = bPixels.Diagonal().x();
+            int height = bPixels.Diagonal().y();
+            int numWeights = (width + 3) & ~3;
+            int lastLanes = width - (numWeights - 4);
+            __m128 lastMask = mm_lookupmask_ps[(1 << lastLanes) - 1];
+            Point2f pFilter(bPixels.min().x() + 0.5f - pSample.x(),
+                            bPixels.min().y() + 0.5f - pSample.y());
+            _filterTable->EvaluateFootprint(pFilter, numWeights, height,
+                                            _weights.data());
 
-            Pixel & pixel = GetPixel(p);
-            pixel.contribSum += weight * L;
-            pixel.weightSum += weight;
+            // Splat the sample into every plane, a row at a time
+            int stride = _pixelBounds.Diagonal().x();
+            float * plane = &_sums[GetPixelOffset(bPixels.min())];
+            for (int s = 0; s < numSums; ++s, plane += _planeSize) {
+                float * row = plane;
+                const float * weights = _weights.data();
+                for (int y = 0; y < height; ++y) {
+                    if (s == WeightSqSum) {
+                        SplatRowSquared(row, weights, width, lastMask);
+                    } else {
+                        SplatRow(row, weights, values[s], width, lastMask);
+                    }
+                    row += stride;
+                    weights += numWeights;
+                }
+            }
+        }
+        if (_pixelBounds.Contains(pPixel)) {
+            int offset = GetPixelOffset(pPixel);
+            ++_sampleCounts[offset];
+            AddAovKeys(offset, accum);
         }
     } else {
-        Pixel & pixel = GetPixel(pPixel);
-        pixel.contribSum += L;
-        pixel.weightSum += 1.f;
+        int offset = GetPixelOffset(pPixel);
+        for (int s = 0; s < numSums; ++s) {
+            _sums[s * _planeSize + offset] += values[s];
+        }
+        ++_sampleCounts[offset];
+        AddAovKeys(offset, accum);
     }
 }
 
-Pixel & FilmTile::GetPixel(const Point2i & p)
+int FilmTile::GetPixelOffset(const Point2i & p) const
 {
     assert(_pixelBounds.Contains(p));
     Vector2i dims = _pixelBounds.Diagonal();
     Vector2i dTile = p - _pixelBounds.min();
-    int offset = dTile.y() * dims.x() + dTile.x();
-    return _pixels[offset];
+    return dTile.y() * dims.x() + dTile.x();
 }
 
-TileGenerator::TileGenerator(Order order, const Vector2i & nTiles)
-    : _order(order), _nTiles(nTiles), _index(0) {}
-
-bool TileGenerator::GenerateNextTile(Point2i & tileIndex)
+void FilmTile::AddAovKeys(int offset, const FilmAccumulator & accum)
 {
-    int index;
-    {
-        std::lock_guard<std::mutex> guard(_mutex);
-        if (_index >= _nTiles.x() * _nTiles.y()) {
-            return false;
+    // Samples that miss the scene have no depth and keep no keys
+    Color depth;
+    if (_aovLayout->numKeys == 0 || !accum.GetAov(Aov::kDepth, depth)) {
+        return;
+    }
+
+    uint64_t * keys = &_aovKeys[offset * _aovLayout->numKeys];
+    for (Aov aov : _aovLayout->keyAovs) {
+        Color value;
+        if (!accum.GetAov(aov, value)) {
+            continue;
         }
-        index = _index++;
+        uint64_t key = GetAovInfo(aov).filter == AovFilter::kMin
+                           ? MakeAovKey(value[0], value[0])
+                           : MakeAovKey(depth[0], value[0]);
+        uint64_t & cur = keys[_aovLayout->offsets[static_cast<int>(aov)]];
+        cur = std::min(cur, key);
     }
+}
 
-    switch (_order) {
+TileGenerator::TileGenerator(Order order, const Vector2i & nTiles,
+                             int numSplitTiles)
+    : _index(0)
+{
+    int numTiles = nTiles.x() * nTiles.y();
+    _tiles.reserve(numTiles);
+
+    auto inside = [&](const Point2i & p) {
+        return p.x() >= 0 && p.x() < nTiles.x() &&
+               p.y() >= 0 && p.y() < nTiles.y();
+    };
+
+    switch (order) {
     case Order::kHorizontal:
-        tileIndex = Point2i(index % _nTiles.x(), index / _nTiles.x());
-        return true;
+        for (int i = 0; i < numTiles; ++i) {
+            _tiles.emplace_back(i % nTiles.x(), i / nTiles.x());
+        }
+        break;
 
     case Order::kVertical:
-        tileIndex = Point2i(index / _nTiles.y(), index % _nTiles.y());
+        for (int i = 0; i < numTiles; ++i) {
+            _tiles.emplace_back(i / nTiles.y(), i % nTiles.y());
+        }
+        break;
+
+    case Order::kSpiral: {
+        // Walk a square spiral around the centre tile, with legs of
+        // length 1, 1, 2, 2, 3, 3, ...
+        const Vector2i dirs[4] = {
+            Vector2i(1, 0), Vector2i(0, 1), Vector2i(-1, 0), Vector2i(0, -1)
+        };
+        Point2i p((nTiles.x() - 1) / 2, (nTiles.y() - 1) / 2);
+        int maxLength = 2 * std::max(nTiles.x(), nTiles.y()) + 1;
+        if (inside(p)) {
+            _tiles.push_back(p);
+        }
+        for (int leg = 0; leg < 2 * maxLength; ++leg) {
+            for (int i = 0; i < leg / 2 + 1; ++i) {
+                p += dirs[leg % 4];
+                if (inside(p)) {
+                    _tiles.push_back(p);
+                }
+            }
+        }
+        break;
+    }
+
+    case Order::kHilbert:
+    case Order::kMorton: {
+        // Walk the curve over the enclosing power of two grid and skip
+        // the tiles outside of the film
+        uint32_t n = RoundUpPow2(std::max(nTiles.x(), nTiles.y()));
+        for (uint32_t d = 0; d < n * n; ++d) {
+            uint32_t x, y;
+            if (order == Order::kHilbert) {
+                DecodeHilbert2(n, d, &x, &y);
+            } else {
+                DecodeMorton2(d, &x, &y);
+            }
+            Point2i p(x, y);
+            if (inside(p)) {
+                _tiles.push_back(p);
+            }
+        }
+        break;
+    }
+    }
+
+    assert(_tiles.size() == static_cast<size_t>(numTiles));
+    _numSplitTiles = std::min(numSplitTiles, numTiles);
+}
+
+bool TileGenerator::GenerateNextTile(Point2i & tileIndex, int & subTile)
+{
+    int index = _index.fetch_add(1, std::memory_order_relaxed);
+
+    int numWholeTiles = static_cast<int>(_tiles.size()) - _numSplitTiles;
+    if (index < numWholeTiles) {
+        tileIndex = _tiles[index];
+        subTile = -1;
         return true;
+    }
 
-    default:
-        Error("");
+    int subIndex = index - numWholeTiles;
+    if (subIndex >= 4 * _numSplitTiles) {
         return false;
     }
+    tileIndex = _tiles[numWholeTiles + subIndex / 4];
+    subTile = subIndex % 4;
+    return true;
 }
 
 Film::Film(const Vector2i & resolution, float pixelAspectRatio,
            const Bounds2f & cropWindow, float frameAspectRatio,
            const Bounds2f & screenWindow, const Vector2i & tileSize,
-           int filterTableSize, FilmSampleMode sampleMode)
+           TileGenerator::Order tileOrder, int filterTableSize,
+           FilmSampleMode sampleMode, float adaptiveThreshold,
+           int adaptiveMinSamples)
     : _resolution(resolution),
       _pixelAspectRatio(pixelAspectRatio),
       _cropWindow(cropWindow),
       _frameAspectRatio(frameAspectRatio),
       _screenWindow(screenWindow),
       _tileSize(tileSize),
+      _tileOrder(tileOrder),
       _filterTableSize(filterTableSize),
-      _sampleMode(sampleMode)
+      _sampleMode(sampleMode),
+      _adaptiveThreshold(adaptiveThreshold),
+      _adaptiveMinSamples(adaptiveMinSamples)
 {
 
     // Create the scanlines for the pixels
@@ -141,21 +598,51 @@ Film::Film(const Vector2i & resolution, float pixelAspectRatio,
                                    _resolution.y() * _cropWindow.max().y())))
     );
 
-    _pixels.resize(std::max(0, _pixelBounds.Volume()));
+    size_t numPixels = std::max(0, _pixelBounds.Volume());
+    _pixels = std::make_unique<FilmPixel[]>(numPixels);
+    for (size_t i = 0; i < numPixels; ++i) {
+        ClearPixel(_pixels[i]);
+    }
+
 }
 
-void Film::RenderBegin(PixelFilter * filter, Display * display)
+Film::~Film()
+{
+    if (_displayThread.joinable()) {
+        _displayThread.join();
+    }
+    WaitForCheckpoint();
+}
+
+void Film::RenderBegin(PixelFilter * filter, Display * display,
+                       const std::vector<Aov> & aovs)
 {
     _filter = filter;
     _display = display;
 
+    _aovLayout = AovLayout(aovs);
+    size_t numPixels = std::max(0, _pixelBounds.Volume());
+    size_t numSums = numPixels * _aovLayout.numSums;
+    _aovSums = std::make_unique<std::atomic<float>[]>(numSums);
+    for (size_t i = 0; i < numSums; ++i) {
+        _aovSums[i].store(0.f, std::memory_order_relaxed);
+    }
+    size_t numKeys = numPixels * _aovLayout.numKeys;
+    _aovKeys = std::make_unique<std::atomic<uint64_t>[]>(numKeys);
+    for (size_t i = 0; i < numKeys; ++i) {
+        _aovKeys[i].store(EmptyAovKey, std::memory_order_relaxed);
+    }
+
     // Calculate the pixels which need to be sampled,
-    // including the border created by the filter
+    // including the border created by the filter. A sample reaches the
+    // pixels whose centres are within the filter radius.
     if (_sampleMode == FilmSampleMode::kConvolution) {
+        Vector2f halfPixel(0.5f);
         Vector2f filterRadius = _filter->GetRadius();
         _sampleBounds = Bounds2i(
-                (Point2i)Ceil(_pixelBounds.min() - filterRadius),
-                (Point2i)Floor(_pixelBounds.max() + filterRadius)
+                (Point2i)Floor(_pixelBounds.min() - halfPixel - filterRadius) +
+                        Point2i(1),
+                (Point2i)Ceil(_pixelBounds.max() - halfPixel + filterRadius)
         );
     } else {
         _sampleBounds = _pixelBounds;
@@ -168,42 +655,181 @@ void Film::RenderBegin(PixelFilter * filter, Display * display)
             (sampleExtent.y() + _tileSize.y() - 1) / _tileSize.y()
     );
 
-    // Create the tile generator
-    _tileGen = std::make_unique<TileGenerator>(
-            TileGenerator::Order::kHorizontal, _nTiles);
-
     // Prepare a filter table
     _filterTable = std::make_unique<FilterTable>(_filter, _filterTableSize);
+
+    // No pixel is converged before it has samples
+    if (IsAdaptive()) {
+        _converged.assign(std::max(0, _pixelBounds.Volume()), 0);
+    }
 }
 
 void Film::RenderEnd()
 {
-    OutputToDisplay();
+    if (_displayThread.joinable()) {
+        _displayThread.join();
+    }
+    WaitForCheckpoint();
+    if (_tileWriter) {
+        // Write the tiles no film tile overlaps, which are outside of the
+        // crop window
+        for (int y = 0; y < _nDisplayTiles.y(); ++y) {
+            for (int x = 0; x < _nDisplayTiles.x(); ++x) {
+                if (!_displayTileWritten[y * _nDisplayTiles.x() + x]) {
+                    WriteDisplayTile(Point2i(x, y));
+                }
+            }
+        }
+        _tileWriter->Finish();
+        _tileWriter.reset();
+        _display->Close();
 
-    // Clear pixels
-    for (Pixel & pixel : _pixels) {
-        pixel.contribSum = Color(0.f);
-        pixel.weightSum = 0.f;
+        _filmTileParts.reset();
+        _displayTileDeps.reset();
+        _displayTileWritten.clear();
+    } else {
+        OutputToDisplay();
     }
 
+    // Clear pixels
+    int width = _pixelBounds.Diagonal().x();
+    ParallelFor(_pixelBounds.min().y(), _pixelBounds.max().y(),
+                ResolveGrainSize, [&](int64_t yBegin, int64_t yEnd) {
+        for (int64_t y = yBegin; y < yEnd; ++y) {
+            FilmPixel * row = &GetPixel(Point2i(_pixelBounds.min().x(), y));
+            for (int x = 0; x < width; ++x) {
+                ClearPixel(row[x]);
+            }
+        }
+    });
+
     // Make sample bounds invalid, to be safe
     _sampleBounds = Bounds2i();
 
     _filter = nullptr;
     _display = nullptr;
+    _converged.clear();
+    _aovSums.reset();
+    _aovKeys.reset();
 
     _tileGen.reset();
     _filterTable.reset();
 }
 
+void Film::StartPass(bool lastPass)
+{
+    // Create the tile generator
+    // Split the tiles that are rendered last when other threads could
+    // otherwise run idle
+    int numThreads = NumThreads();
+    int numSplitTiles = numThreads > 1 ? 2 * numThreads : 0;
+    _tileGen = std::make_unique<TileGenerator>(_tileOrder, _nTiles,
+                                               numSplitTiles);
+
+    if (!lastPass) {
+        return;
+    }
+
+    // The display has to finish the intermediate image before it takes
+    // tiles
+    if (_displayThread.joinable()) {
+        _displayThread.join();
+    }
+    if (!_display->OpenTiles(_resolution, _tileSize,
+                             _aovLayout.channelNames)) {
+        return;
+    }
+
+    // Whole tiles count as four quarters, sub-tiles as one
+    int numFilmTiles = GetNumTiles();
+    _filmTileParts = std::make_unique<std::atomic<int>[]>(numFilmTiles);
+    for (int i = 0; i < numFilmTiles; ++i) {
+        _filmTileParts[i].store(4, std::memory_order_relaxed);
+    }
+
+    // Count the film tiles whose pixels overlap every display tile
+    _nDisplayTiles = Vector2i(
+            (_resolution.x() + _tileSize.x() - 1) / _tileSize.x(),
+            (_resolution.y() + _tileSize.y() - 1) / _tileSize.y());
+    int numDisplayTiles = _nDisplayTiles.x() * _nDisplayTiles.y();
+    _displayTileDeps = std::make_unique<std::atomic<int>[]>(numDisplayTiles);
+    for (int i = 0; i < numDisplayTiles; ++i) {
+        _displayTileDeps[i].store(0, std::memory_order_relaxed);
+    }
+    _displayTileWritten.assign(numDisplayTiles, 0);
+    Bounds2i tileRange(Point2i(0, 0), Point2i(0, 0) + _nTiles);
+    for (Point2i tileIndex : tileRange) {
+        for (Point2i d : GetDisplayTileRange(tileIndex)) {
+            _displayTileDeps[d.y() * _nDisplayTiles.x() + d.x()].fetch_add(
+                    1, std::memory_order_relaxed);
+        }
+    }
+
+    _tileWriter = std::make_unique<DisplayTileWriter>(_display);
+}
+
+void Film::UpdateDisplay()
+{
+    assert(_display != nullptr);
+
+    if (_displayBusy.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (_displayThread.joinable()) {
+        _displayThread.join();
+    }
+
+    // The resolved pixels are left alone until the thread is done
+    ResolvePixels();
+    _displayBusy.store(true, std::memory_order_relaxed);
+    _displayThread = std::thread([this]() {
+        WriteToDisplay();
+        _displayBusy.store(false, std::memory_order_release);
+    });
+}
+
 std::unique_ptr<FilmTile> Film::GetNextTile() const
 {
     // Get a new tile
     Point2i tileIndex;
-    if (!_tileGen->GenerateNextTile(tileIndex)) {
+    int subTile;
+    if (!_tileGen->GenerateNextTile(tileIndex, subTile)) {
         return std::unique_ptr<FilmTile>();
     }
 
+    int tileId = _nTiles.x() * tileIndex.y() + tileIndex.x();
+    if (subTile < 0) {
+        auto tile = std::make_unique<FilmTile>(
+                tileId, tileIndex, GetTilePixelBounds(tileIndex),
+                GetTileSampleBounds(tileIndex), _filter, _filterTable.get(),
+                _sampleMode, &_aovLayout);
+        tile->_ownedBounds = GetTileOwnedBounds(tileIndex);
+        return tile;
+    }
+
+    // Take a quadrant of the tile. Sub-tiles get ids after the ones of the
+    // tiles, and share all their pixels with other tiles.
+    Bounds2i tileSampleBounds = GetTileSampleBounds(tileIndex);
+    Point2i pMin = tileSampleBounds.min();
+    Point2i pMax = tileSampleBounds.max();
+    Point2i pMid = pMin + tileSampleBounds.Diagonal() / 2;
+    Bounds2i subSampleBounds(
+            Point2i((subTile & 1) ? pMid.x() : pMin.x(),
+                    (subTile & 2) ? pMid.y() : pMin.y()),
+            Point2i((subTile & 1) ? pMax.x() : pMid.x(),
+                    (subTile & 2) ? pMax.y() : pMid.y()));
+    int subTileId = GetNumTiles() + 4 * tileId + subTile;
+    auto tile = std::make_unique<FilmTile>(
+            subTileId, tileIndex, GetPixelBounds(subSampleBounds),
+            subSampleBounds, _filter, _filterTable.get(), _sampleMode,
+            &_aovLayout);
+    tile->_ownedBounds = Bounds2i(subSampleBounds.min(),
+                                  subSampleBounds.min());
+    return tile;
+}
+
+Bounds2i Film::GetTileSampleBounds(const Point2i & tileIndex) const
+{
     // Calculate the pixels which need to be sampled
     Vector2i tileOffset(tileIndex.x() * _tileSize.x(),
                         tileIndex.y() * _tileSize.y());
@@ -211,9 +837,16 @@ std::unique_ptr<FilmTile> Film::GetNextTile() const
             _sampleBounds.min() + tileOffset,
             _sampleBounds.min() + tileOffset + _tileSize
     );
-    Bounds2i b = tileSampleBounds;
-    tileSampleBounds = Intersection(_sampleBounds, tileSampleBounds);
+    return Intersection(_sampleBounds, tileSampleBounds);
+}
 
+Bounds2i Film::GetTilePixelBounds(const Point2i & tileIndex) const
+{
+    return GetPixelBounds(GetTileSampleBounds(tileIndex));
+}
+
+Bounds2i Film::GetPixelBounds(const Bounds2i & tileSampleBounds) const
+{
     // Calculate the pixels for which values need to be stored
     Bounds2i tilePixelBounds;
     if (_sampleMode == FilmSampleMode::kConvolution) {
@@ -226,26 +859,416 @@ std::unique_ptr<FilmTile> Film::GetNextTile() const
     } else {
         tilePixelBounds = tileSampleBounds;
     }
-    tilePixelBounds = Intersection(_sampleBounds, tilePixelBounds);
+    return Intersection(_sampleBounds, tilePixelBounds);
+}
 
-    int tileId = _nTiles.x() * tileIndex.y() + tileIndex.x();
-    return std::make_unique<FilmTile>(tileId, tileIndex, tilePixelBounds,
-                                      tileSampleBounds, _filter,
-                                      _filterTable.get(), _sampleMode);
+Bounds2i Film::GetTileOwnedBounds(const Point2i & tileIndex) const
+{
+    // The tiles form a grid, and the pixel bounds grow with the tile index.
+    // So the pixels shared with any other tile are the ones shared with the
+    // direct neighbours.
+    Bounds2i owned = GetTilePixelBounds(tileIndex);
+    for (int d = 0; d < 2; ++d) {
+        Point2i prev = tileIndex;
+        Point2i next = tileIndex;
+        --prev[d];
+        ++next[d];
+        if (prev[d] >= 0) {
+            owned.min()[d] = std::max(owned.min()[d],
+                                      GetTilePixelBounds(prev).max()[d]);
+        }
+        if (next[d] < _nTiles[d]) {
+            owned.max()[d] = std::min(owned.max()[d],
+                                      GetTilePixelBounds(next).min()[d]);
+        }
+        owned.max()[d] = std::max(owned.min()[d], owned.max()[d]);
+    }
+    return owned;
 }
 
 void Film::MergeFilmTile(std::unique_ptr<FilmTile> tile)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-
+    // Pixels owned by the tile are only written by this thread, the others
+    // are added atomically, so merges never wait for each other
     Bounds2i bPixels = Intersection(_pixelBounds, tile->_pixelBounds);
-    for (Point2i p : bPixels) {
-        Pixel & pixelTile = tile->GetPixel(p);
-        Pixel & pixelFilm = GetPixel(p);
+    const Bounds2i & owned = tile->_ownedBounds;
+    int numSums = _aovLayout.numSums;
+    int numKeys = _aovLayout.numKeys;
+    int planeSize = tile->_planeSize;
+    for (int y = bPixels.min().y(); y < bPixels.max().y(); ++y) {
+        bool ownedRow = y >= owned.min().y() && y < owned.max().y();
+        for (int x = bPixels.min().x(); x < bPixels.max().x(); ++x) {
+            Point2i p(x, y);
+            int tileOffset = tile->GetPixelOffset(p);
+            int filmOffset = GetPixelOffset(p);
+
+            // Gather the sums of the pixel from the planes of the tile
+            float sumsTile[MaxTileSums];
+            for (int s = 0; s < NumPixelSums + numSums; ++s) {
+                sumsTile[s] = tile->_sums[s * planeSize + tileOffset];
+            }
+            const float * aovSumsTile = sumsTile + NumPixelSums;
+            int sampleCount = tile->_sampleCounts[tileOffset];
+            const uint64_t * keysTile = &tile->_aovKeys[tileOffset * numKeys];
+
+            FilmPixel & pixelFilm = _pixels[filmOffset];
+            std::atomic<float> * sumsFilm = &_aovSums[filmOffset * numSums];
+            std::atomic<uint64_t> * keysFilm = &_aovKeys[filmOffset * numKeys];
 
-        pixelFilm.contribSum += pixelTile.contribSum;
-        pixelFilm.weightSum += pixelTile.weightSum;
+            if (ownedRow && x >= owned.min().x() && x < owned.max().x()) {
+                for (int c = 0; c < 3; ++c) {
+                    ExclusiveAdd(pixelFilm.contribSum[c],
+                                 sumsTile[ContribSum + c]);
+                }
+                ExclusiveAdd(pixelFilm.weightSum, sumsTile[WeightSum]);
+                ExclusiveAdd(pixelFilm.luminanceSqSum,
+                             sumsTile[LuminanceSqSum]);
+                ExclusiveAdd(pixelFilm.weightSqSum, sumsTile[WeightSqSum]);
+                ExclusiveAdd(pixelFilm.sampleCount, sampleCount);
+                for (int i = 0; i < numSums; ++i) {
+                    ExclusiveAdd(sumsFilm[i], aovSumsTile[i]);
+                }
+                for (int i = 0; i < numKeys; ++i) {
+                    ExclusiveMin(keysFilm[i], keysTile[i]);
+                }
+            } else {
+                for (int c = 0; c < 3; ++c) {
+                    AtomicAdd(pixelFilm.contribSum[c],
+                              sumsTile[ContribSum + c]);
+                }
+                AtomicAdd(pixelFilm.weightSum, sumsTile[WeightSum]);
+                AtomicAdd(pixelFilm.luminanceSqSum, sumsTile[LuminanceSqSum]);
+                AtomicAdd(pixelFilm.weightSqSum, sumsTile[WeightSqSum]);
+                AtomicAdd(pixelFilm.sampleCount, sampleCount);
+                for (int i = 0; i < numSums; ++i) {
+                    AtomicAdd(sumsFilm[i], aovSumsTile[i]);
+                }
+                for (int i = 0; i < numKeys; ++i) {
+                    AtomicMin(keysFilm[i], keysTile[i]);
+                }
+            }
+        }
     }
+
+    // The film tile is finished when all of its quarters are merged
+    if (_tileWriter) {
+        const Point2i & tileIndex = tile->_index;
+        int parts = tile->_tileId < GetNumTiles() ? 4 : 1;
+        int filmTile = tileIndex.y() * _nTiles.x() + tileIndex.x();
+        if (_filmTileParts[filmTile].fetch_sub(
+                    parts, std::memory_order_acq_rel) == parts) {
+            FinishFilmTile(tileIndex);
+        }
+    }
+}
+
+Bounds2i Film::GetDisplayTileRange(const Point2i & tileIndex) const
+{
+    // The display tiles overlapping the pixels of the film tile
+    Bounds2i bPixels = Intersection(_pixelBounds,
+                                    GetTilePixelBounds(tileIndex));
+    if (bPixels.IsDegenerate()) {
+        return Bounds2i(Point2i(0, 0), Point2i(0, 0));
+    }
+    return Bounds2i(
+            Point2i(bPixels.min().x() / _tileSize.x(),
+                    bPixels.min().y() / _tileSize.y()),
+            Point2i((bPixels.max().x() - 1) / _tileSize.x() + 1,
+                    (bPixels.max().y() - 1) / _tileSize.y() + 1));
+}
+
+Bounds2i Film::GetDisplayTileBounds(const Point2i & displayTile) const
+{
+    Point2i pMin(displayTile.x() * _tileSize.x(),
+                 displayTile.y() * _tileSize.y());
+    return Intersection(Bounds2i(pMin, pMin + _tileSize),
+                        Bounds2i(Point2i(0, 0), Point2i(0, 0) + _resolution));
+}
+
+void Film::FinishFilmTile(const Point2i & tileIndex)
+{
+    // The thread finishing the last film tile overlapping a display tile
+    // sees the pixels merged by the others, and writes it
+    for (Point2i d : GetDisplayTileRange(tileIndex)) {
+        int displayTile = d.y() * _nDisplayTiles.x() + d.x();
+        if (_displayTileDeps[displayTile].fetch_sub(
+                    1, std::memory_order_acq_rel) == 1) {
+            WriteDisplayTile(d);
+        }
+    }
+}
+
+void Film::WriteDisplayTile(const Point2i & displayTile)
+{
+    Bounds2i bounds = GetDisplayTileBounds(displayTile);
+    std::vector<float> pixels(_aovLayout.channelNames.size() *
+                              bounds.Volume());
+    ResolveRegion(bounds, pixels.data());
+    _displayTileWritten[displayTile.y() * _nDisplayTiles.x() +
+                        displayTile.x()] = 1;
+    _tileWriter->Push(bounds, std::move(pixels));
+}
+
+bool Film::IsConverged(const Point2i & pixel) const
+{
+    if (_converged.empty()) {
+        return false;
+    }
+
+    Vector2i dims = _pixelBounds.Diagonal();
+    int x = std::min(std::max(pixel.x() - _pixelBounds.min().x(), 0),
+                     dims.x() - 1);
+    int y = std::min(std::max(pixel.y() - _pixelBounds.min().y(), 0),
+                     dims.y() - 1);
+    return _converged[y * dims.x() + x] != 0;
+}
+
+int64_t Film::UpdateConvergence()
+{
+    if (_converged.empty()) {
+        return std::max(0, _pixelBounds.Volume());
+    }
+
+    std::atomic<int64_t> numActive(0);
+    int width = _pixelBounds.Diagonal().x();
+    ParallelFor(_pixelBounds.min().y(), _pixelBounds.max().y(),
+                ResolveGrainSize, [&](int64_t yBegin, int64_t yEnd) {
+        int64_t rowActive = 0;
+        for (int64_t y = yBegin; y < yEnd; ++y) {
+            int64_t rowOffset = (y - _pixelBounds.min().y()) * width;
+            FilmPixel * row = &GetPixel(Point2i(_pixelBounds.min().x(), y));
+            for (int x = 0; x < width; ++x) {
+                const FilmPixel & pixel = row[x];
+                int sampleCount =
+                        pixel.sampleCount.load(std::memory_order_relaxed);
+                float error;
+                bool converged = sampleCount >= _adaptiveMinSamples &&
+                                 EstimatePixelError(pixel, &error) &&
+                                 error < _adaptiveThreshold;
+                _converged[rowOffset + x] = converged;
+                rowActive += !converged;
+            }
+        }
+        numActive.fetch_add(rowActive, std::memory_order_relaxed);
+    });
+    return numActive.load();
+}
+
+void Film::EstimateConvergence(double * meanSamples, double * meanError)
+{
+    // Sum the rows in parallel, and the row sums in order
+    int64_t height = _pixelBounds.Diagonal().y();
+    int width = _pixelBounds.Diagonal().x();
+    std::vector<double> rowSamples(std::max<int64_t>(0, height), 0.0);
+    std::vector<double> rowErrors(rowSamples.size(), 0.0);
+    std::vector<int64_t> rowNumErrors(rowSamples.size(), 0);
+    ParallelFor(0, height, ResolveGrainSize,
+                [&](int64_t rowBegin, int64_t rowEnd) {
+        for (int64_t r = rowBegin; r < rowEnd; ++r) {
+            const FilmPixel * row = &GetPixel(
+                    _pixelBounds.min() + Vector2i(0, r));
+            for (int x = 0; x < width; ++x) {
+                rowSamples[r] +=
+                        row[x].sampleCount.load(std::memory_order_relaxed);
+                float error;
+                if (EstimatePixelError(row[x], &error)) {
+                    rowErrors[r] += error;
+                    ++rowNumErrors[r];
+                }
+            }
+        }
+    });
+
+    double samples = 0.0, errors = 0.0;
+    int64_t numErrors = 0;
+    for (size_t r = 0; r < rowSamples.size(); ++r) {
+        samples += rowSamples[r];
+        errors += rowErrors[r];
+        numErrors += rowNumErrors[r];
+    }
+    int64_t numPixels = std::max(0, _pixelBounds.Volume());
+    *meanSamples = numPixels > 0 ? samples / numPixels : 0.0;
+    *meanError = numErrors > 0 ? errors / numErrors : 0.0;
+}
+
+void Film::WriteCheckpoint(const std::string & filename,
+                           const CheckpointProgress & progress)
+{
+    if (_checkpointBusy.load(std::memory_order_acquire)) {
+        return;
+    }
+    WaitForCheckpoint();
+
+    CheckpointHeader header;
+    std::memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+    header.version = CheckpointVersion;
+    header.pixelBounds[0] = _pixelBounds.min().x();
+    header.pixelBounds[1] = _pixelBounds.min().y();
+    header.pixelBounds[2] = _pixelBounds.max().x();
+    header.pixelBounds[3] = _pixelBounds.max().y();
+    header.progress = progress;
+    header.hasConverged = !_converged.empty();
+    header.numAovSums = _aovLayout.numSums;
+    header.numAovKeys = _aovLayout.numKeys;
+
+    // Copy the pixels, so the render continues while the file is written
+    int width = _pixelBounds.Diagonal().x();
+    size_t numPixels = std::max(0, _pixelBounds.Volume());
+    size_t numSums = numPixels * _aovLayout.numSums;
+    size_t numKeys = numPixels * _aovLayout.numKeys;
+    _checkpointData.resize(sizeof(CheckpointHeader) +
+                           numPixels * sizeof(CheckpointPixel) +
+                           _converged.size() + numSums * sizeof(float) +
+                           numKeys * sizeof(uint64_t));
+    std::memcpy(_checkpointData.data(), &header, sizeof(header));
+    char * pixelData = _checkpointData.data() + sizeof(CheckpointHeader);
+    ParallelFor(_pixelBounds.min().y(), _pixelBounds.max().y(),
+                ResolveGrainSize, [&](int64_t yBegin, int64_t yEnd) {
+        for (int64_t y = yBegin; y < yEnd; ++y) {
+            size_t rowOffset = (y - _pixelBounds.min().y()) * width;
+            const FilmPixel * row =
+                    &GetPixel(Point2i(_pixelBounds.min().x(), y));
+            for (int x = 0; x < width; ++x) {
+                const FilmPixel & src = row[x];
+                CheckpointPixel pixel;
+                for (int c = 0; c < 3; ++c) {
+                    pixel.contribSum[c] =
+                            src.contribSum[c].load(std::memory_order_relaxed);
+                }
+                pixel.weightSum = src.weightSum.load(std::memory_order_relaxed);
+                pixel.luminanceSqSum =
+                        src.luminanceSqSum.load(std::memory_order_relaxed);
+                pixel.weightSqSum =
+                        src.weightSqSum.load(std::memory_order_relaxed);
+                pixel.sampleCount =
+                        src.sampleCount.load(std::memory_order_relaxed);
+                std::memcpy(pixelData + (rowOffset + x) * sizeof(pixel),
+                            &pixel, sizeof(pixel));
+            }
+        }
+    });
+    char * convergedData = pixelData + numPixels * sizeof(CheckpointPixel);
+    std::memcpy(convergedData, _converged.data(), _converged.size());
+
+    char * sumData = convergedData + _converged.size();
+    for (size_t i = 0; i < numSums; ++i) {
+        float sum = _aovSums[i].load(std::memory_order_relaxed);
+        std::memcpy(sumData + i * sizeof(float), &sum, sizeof(float));
+    }
+    char * keyData = sumData + numSums * sizeof(float);
+    for (size_t i = 0; i < numKeys; ++i) {
+        uint64_t key = _aovKeys[i].load(std::memory_order_relaxed);
+        std::memcpy(keyData + i * sizeof(uint64_t), &key, sizeof(uint64_t));
+    }
+
+    // Write to a temporary file first, so an interrupted write keeps the
+    // previous checkpoint intact
+    _checkpointBusy.store(true, std::memory_order_relaxed);
+    _checkpointThread = std::thread([this, filename]() {
+        std::string tempFilename = filename + ".tmp";
+        std::ofstream file(tempFilename, std::ios::binary);
+        file.write(_checkpointData.data(), _checkpointData.size());
+        file.close();
+        if (!file) {
+            Error("Could not write checkpoint file \"%s\"", tempFilename);
+        } else if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+            Error("Could not rename checkpoint file \"%s\"", tempFilename);
+        }
+        _checkpointBusy.store(false, std::memory_order_release);
+    });
+}
+
+void Film::WaitForCheckpoint()
+{
+    if (_checkpointThread.joinable()) {
+        _checkpointThread.join();
+    }
+}
+
+bool Film::ReadCheckpoint(const std::string & filename,
+                          CheckpointProgress * progress)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        Warning("Could not open checkpoint file \"%s\"", filename);
+        return false;
+    }
+
+    CheckpointHeader header;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file ||
+        std::memcmp(header.magic, CheckpointMagic, sizeof(header.magic)) ||
+        header.version != CheckpointVersion) {
+        Warning("\"%s\" is not a checkpoint file", filename);
+        return false;
+    }
+    if (header.pixelBounds[0] != _pixelBounds.min().x() ||
+        header.pixelBounds[1] != _pixelBounds.min().y() ||
+        header.pixelBounds[2] != _pixelBounds.max().x() ||
+        header.pixelBounds[3] != _pixelBounds.max().y()) {
+        Warning("Checkpoint \"%s\" was written for other film bounds",
+                filename);
+        return false;
+    }
+    if (header.progress.samplesPerPixel != progress->samplesPerPixel) {
+        Warning("Checkpoint \"%s\" was written with other samples per "
+                "pixel", filename);
+        return false;
+    }
+    if (header.numAovSums != _aovLayout.numSums ||
+        header.numAovKeys != _aovLayout.numKeys) {
+        Warning("Checkpoint \"%s\" was written for other AOVs", filename);
+        return false;
+    }
+
+    size_t numPixels = std::max(0, _pixelBounds.Volume());
+    std::vector<CheckpointPixel> pixels(numPixels);
+    file.read(reinterpret_cast<char *>(pixels.data()),
+              numPixels * sizeof(CheckpointPixel));
+    std::vector<uint8_t> converged(header.hasConverged ? numPixels : 0);
+    file.read(reinterpret_cast<char *>(converged.data()), converged.size());
+    std::vector<float> sums(numPixels * _aovLayout.numSums);
+    file.read(reinterpret_cast<char *>(sums.data()),
+              sums.size() * sizeof(float));
+    std::vector<uint64_t> keys(numPixels * _aovLayout.numKeys);
+    file.read(reinterpret_cast<char *>(keys.data()),
+              keys.size() * sizeof(uint64_t));
+    if (!file) {
+        Warning("Checkpoint \"%s\" is truncated", filename);
+        return false;
+    }
+
+    for (size_t i = 0; i < numPixels; ++i) {
+        const CheckpointPixel & pixel = pixels[i];
+        for (int c = 0; c < 3; ++c) {
+            _pixels[i].contribSum[c].store(pixel.contribSum[c],
+                                           std::memory_order_relaxed);
+        }
+        _pixels[i].weightSum.store(pixel.weightSum,
+                                   std::memory_order_relaxed);
+        _pixels[i].luminanceSqSum.store(pixel.luminanceSqSum,
+                                        std::memory_order_relaxed);
+        _pixels[i].weightSqSum.store(pixel.weightSqSum,
+                                     std::memory_order_relaxed);
+        _pixels[i].sampleCount.store(pixel.sampleCount,
+                                     std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < sums.size(); ++i) {
+        _aovSums[i].store(sums[i], std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        _aovKeys[i].store(keys[i], std::memory_order_relaxed);
+    }
+
+    // Converged flags only matter if this render samples adaptively
+    if (!_converged.empty() && !converged.empty()) {
+        _converged = converged;
+    }
+
+    progress->numSamples = header.progress.numSamples;
+    progress->numPasses = header.progress.numPasses;
+    return true;
 }
 
 Point2f Film::RasterToScreen(const Point2f & pRaster) const
@@ -263,41 +1286,110 @@ Point2f Film::RasterToScreen(const Point2f & pRaster) const
                    pNDC.y() * d.y() + _screenWindow.max().y());
 }
 
-void Film::OutputToDisplay()
+void Film::ResolveRegion(const Bounds2i & bounds, float * pixels)
 {
-    assert(_display != nullptr);
+    // Pixels outside of the crop window are black
+    const int nChannels = _aovLayout.channelNames.size();
+    int width = bounds.Diagonal().x();
+    for (int y = bounds.min().y(); y < bounds.max().y(); ++y) {
+        float * row = pixels + nChannels * (y - bounds.min().y()) * width;
+        for (int x = bounds.min().x(); x < bounds.max().x(); ++x) {
+            Point2i p(x, y);
+            float * pixel = row + nChannels * (x - bounds.min().x());
+            if (p.x() < _pixelBounds.min().x() ||
+                p.x() >= _pixelBounds.max().x() ||
+                p.y() < _pixelBounds.min().y() ||
+                p.y() >= _pixelBounds.max().y()) {
+                std::fill(pixel, pixel + nChannels, 0.f);
+                continue;
+            }
 
-    const int nChannels = 3;
-    std::vector<float> pixels(_resolution.x() * _resolution.y() * nChannels);
-    
-    for (Point2i p : _pixelBounds) {
-        Pixel & pixel = GetPixel(p);
+            int offset = GetPixelOffset(p);
+            const FilmPixel & filmPixel = _pixels[offset];
+            for (Aov aov : _aovLayout.aovs) {
+                const AovInfo & info = GetAovInfo(aov);
+                int first = _aovLayout.offsets[static_cast<int>(aov)];
+                Color value;
+                if (aov == Aov::kColor) {
+                    value = ResolvePixel(filmPixel);
+                } else if (info.filter == AovFilter::kAverage) {
+                    const std::atomic<float> * sums =
+                            &_aovSums[offset * _aovLayout.numSums + first];
+                    float weightSum =
+                            filmPixel.weightSum.load(std::memory_order_relaxed);
+                    for (int c = 0; c < info.numChannels; ++c) {
+                        value[c] = sums[c].load(std::memory_order_relaxed);
+                        if (weightSum != 0.f) {
+                            value[c] /= weightSum;
+                        }
+                    }
+                } else if (info.filter == AovFilter::kCount) {
+                    value = Color(static_cast<float>(
+                            filmPixel.sampleCount.load(
+                                    std::memory_order_relaxed)));
+                } else {
+                    // Pixels without a hit are infinitely far away
+                    const std::atomic<uint64_t> & key =
+                            _aovKeys[offset * _aovLayout.numKeys + first];
+                    uint64_t k = key.load(std::memory_order_relaxed);
+                    if (k != EmptyAovKey) {
+                        value = Color(GetAovKeyValue(k));
+                    } else if (info.filter == AovFilter::kMin) {
+                        value = Color(Infinity);
+                    } else {
+                        value = Color(0.f);
+                    }
+                }
 
-        Color finalColor = pixel.contribSum;
-        if (pixel.weightSum != 0.f) {
-            // Error("%f", pixel.weightSum);
-            finalColor /= pixel.weightSum;
+                for (int c = 0; c < info.numChannels; ++c) {
+                    *(pixel++) = value[c];
+                }
+            }
         }
-
-        size_t offset = p.y() * _resolution.x() + p.x();
-        pixels[nChannels * offset] = finalColor.r();
-        pixels[nChannels * offset + 1] = finalColor.g();
-        pixels[nChannels * offset + 2] = finalColor.b();
     }
+}
 
-    _display->Open(_resolution);
-    _display->WriteData(pixels.data());
+void Film::ResolvePixels()
+{
+    const int nChannels = _aovLayout.channelNames.size();
+    _resolved.resize(nChannels * _resolution.x() * _resolution.y());
+
+    // Resolve the rows in parallel
+    ParallelFor(0, _resolution.y(), ResolveGrainSize,
+                [&](int64_t yBegin, int64_t yEnd) {
+        Bounds2i rows(Point2i(0, yBegin), Point2i(_resolution.x(), yEnd));
+        size_t offset = nChannels * yBegin * _resolution.x();
+        ResolveRegion(rows, &_resolved[offset]);
+    });
+}
+
+void Film::WriteToDisplay()
+{
+    _display->Open(_resolution, _aovLayout.channelNames);
+    _display->WriteData(_resolved.data());
     _display->Close();
 }
 
-Pixel & Film::GetPixel(const Point2i & pRaster)
+void Film::OutputToDisplay()
+{
+    assert(_display != nullptr);
+
+    ResolvePixels();
+    WriteToDisplay();
+}
+
+int Film::GetPixelOffset(const Point2i & pRaster) const
 {
     assert(_pixelBounds.Contains(pRaster));
 
     Vector2i dims = _pixelBounds.Diagonal();
     Vector2i d = pRaster - _pixelBounds.min();
-    int offset = d.y() * dims.x() + d.x();
-    return _pixels[offset];
+    return d.y() * dims.x() + d.x();
+}
+
+FilmPixel & Film::GetPixel(const Point2i & pRaster)
+{
+    return _pixels[GetPixelOffset(pRaster)];
 }
 
 std::unique_ptr<Film> CreateFilm(ParameterList & params)
@@ -363,6 +1455,25 @@ std::unique_ptr<Film> CreateFilm(ParameterList & params)
     tileSize.x() = params.GetInt("xtile", &defTileSize);
     tileSize.y() = params.GetInt("ytile", &defTileSize);
 
+    // Tile Order
+    TileGenerator::Order tileOrder;
+    std::string defTileOrder = "hilbert";
+    std::string order = params.GetString("tileorder", &defTileOrder);
+    if (order == "horizontal") {
+        tileOrder = TileGenerator::Order::kHorizontal;
+    } else if (order == "vertical") {
+        tileOrder = TileGenerator::Order::kVertical;
+    } else if (order == "spiral") {
+        tileOrder = TileGenerator::Order::kSpiral;
+    } else if (order == "hilbert") {
+        tileOrder = TileGenerator::Order::kHilbert;
+    } else if (order == "morton") {
+        tileOrder = TileGenerator::Order::kMorton;
+    } else {
+        Error("CreateFilm(): unknown tile order \"%s\"", order);
+        tileOrder = TileGenerator::Order::kHilbert;
+    }
+
     // Filter Table Size
     int defFilterTableSize = 16;
     int filterTableSize = params.GetInt("filterTableSize",
@@ -380,8 +1491,18 @@ std::unique_ptr<Film> CreateFilm(ParameterList & params)
         Error("");
     }
 
+    // Adaptive sampling stops sampling pixels whose relative error falls
+    // below the threshold, zero takes all samples in every pixel
+    float defAdaptiveThreshold = 0.f;
+    float adaptiveThreshold = params.GetFloat("adaptivethreshold",
+                                              &defAdaptiveThreshold);
+    int defAdaptiveMinSamples = 16;
+    int adaptiveMinSamples = std::max(
+            1, params.GetInt("adaptiveminsamples", &defAdaptiveMinSamples));
+
     return std::make_unique<Film>(resolution, pixel, crop, frame, screen,
-                                  tileSize, filterTableSize, mode);
+                                  tileSize, tileOrder, filterTableSize, mode,
+                                  adaptiveThreshold, adaptiveMinSamples);
 }
 
 } // namespace renoster
@@ -3,6 +3,7 @@
 namespace renoster {
 
 FilmAccumulator::FilmAccumulator()
+    : aovMask_(0)
 {
 }
 
@@ -21,9 +22,27 @@ void FilmAccumulator::GetValue(Color & value) const
     value = value_;
 }
 
+void FilmAccumulator::WriteAov(Aov aov, const Color & value)
+{
+    int i = static_cast<int>(aov);
+    aovs_[i] = value;
+    aovMask_ |= 1u << i;
+}
+
+bool FilmAccumulator::GetAov(Aov aov, Color & value) const
+{
+    int i = static_cast<int>(aov);
+    if (!(aovMask_ & (1u << i))) {
+        return false;
+    }
+    value = aovs_[i];
+    return true;
+}
+
 void FilmAccumulator::Reset()
 {
     value_ = Color(0.f);
+    aovMask_ = 0;
 }
 
 } // namespace renoster
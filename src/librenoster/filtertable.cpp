@@ -1,5 +1,10 @@
 #include "renoster/filtertable.h"
 
+#include <algorithm>
+#include <cstdint>
+
+#include "renoster/util/vfloat4.h"
+
 namespace renoster {
 
 FilterTable::FilterTable(const PixelFilter * filter, int tableSize)
@@ -15,8 +20,8 @@ FilterTable::FilterTable(const PixelFilter * filter, int tableSize)
     {
         for (int x = -_tableSize; x < _tableSize; ++x)
         {
-            Point2f p((x + 0.5f) * _invRadius.x() / _tableSize,
-                      (y + 0.5f) * _invRadius.y() / _tableSize);
+            Point2f p((x + 0.5f) * _radius.x() / _tableSize,
+                      (y + 0.5f) * _radius.y() / _tableSize);
             _table[offset++] = _filter->Evaluate(p);
         }
     }
@@ -29,20 +34,66 @@ FilterTable::FilterTable(const PixelFilter * filter, int tableSize)
     _pTable = Distribution2D(std::move(absTable), Point2i(2 * _tableSize));
 }
 
-float FilterTable::Evaluate(const Point2f & p) const
+int FilterTable::GetIndex(float p, float invRadius) const
 {
-    // Map to [-1, 1] x [-1, 1]
-    Point2f pFilter(p.x() / _invRadius.x(), p.y() / _invRadius.y());
+    // Map to [-1, 1], and then to [0, 2 * tS]
+    float t = (p * invRadius + 1.f) * _tableSize;
 
-    // Map to [0, 2 * tS] x [0, 2 * tS]
-    Point2f pTable = (pFilter + Vector2f(1.f)) * _tableSize;
+    // Clamping first makes the truncation round down
+    t = std::min(std::max(t, 0.f), 2.f * _tableSize - 1.f);
+    return static_cast<int>(t);
+}
 
-    int ix = std::min((int)std::floor(pTable.x()), 2 * _tableSize - 1);
-    int iy = std::min((int)std::floor(pTable.y()), 2 * _tableSize - 1);
+float FilterTable::Evaluate(const Point2f & p) const
+{
+    int ix = GetIndex(p.x(), _invRadius.x());
+    int iy = GetIndex(p.y(), _invRadius.y());
 
     return _table[iy * 2 * _tableSize + ix];
 }
 
+void FilterTable::EvaluateFootprint(const Point2f & p, int width, int height,
+                                    float * weights) const
+{
+    // The points of a column share the column of the table. Compute the
+    // columns of four points at a time.
+    const vfloat4 offsets(0.f, 1.f, 2.f, 3.f);
+    const vfloat4 invRadius(_invRadius.x());
+    const vfloat4 tableSize(static_cast<float>(_tableSize));
+    const vfloat4 maxIndex(2.f * _tableSize - 1.f);
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        vfloat4 px = vfloat4(p.x()) +
+                     (offsets + vfloat4(static_cast<float>(x)));
+        vfloat4 t = (px * invRadius + vfloat4(1.f)) * tableSize;
+        t = Min(Max(t, vfloat4(0.f)), maxIndex);
+
+        alignas(16) int32_t ix[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(ix), _mm_cvttps_epi32(t));
+        for (int y = 0; y < height; ++y)
+        {
+            const float * row = &_table[GetIndex(p.y() + static_cast<float>(y),
+                                                 _invRadius.y()) *
+                                        2 * _tableSize];
+            float * w = weights + y * width + x;
+            w[0] = row[ix[0]];
+            w[1] = row[ix[1]];
+            w[2] = row[ix[2]];
+            w[3] = row[ix[3]];
+        }
+    }
+    for (; x < width; ++x)
+    {
+        int ix = GetIndex(p.x() + static_cast<float>(x), _invRadius.x());
+        for (int y = 0; y < height; ++y)
+        {
+            int iy = GetIndex(p.y() + static_cast<float>(y), _invRadius.y());
+            weights[y * width + x] = _table[iy * 2 * _tableSize + ix];
+        }
+    }
+}
+
 float FilterTable::Sample(Point2f & p, const Point2f & uv, float * pdf) const
 {
     Point2f pTable = _pTable.SampleContinuous(uv, pdf);
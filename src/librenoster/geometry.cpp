@@ -19,6 +19,11 @@ float Geometry::Pdf(const GeometryContext & ctx, const ShadingPoint &,
     return Pdf(ctx, pos);
 }
 
+DirectionCone Geometry::GetNormalCone(const GeometryContext &) const
+{
+    return DirectionCone::EntireSphere();
+}
+
 Bounds3f Geometry::GetWorldBounds(const GeometryContext & ctx) const
 {
     return ctx.ObjectToWorld(GetObjectBounds());
@@ -86,6 +86,10 @@ using namespace renoster;
 %token INTEGRATOR
 %token LOOKAT
 %token MATERIAL
+%token OBJECTBEGIN
+%token OBJECTEND
+%token OBJECTINSTANCE
+%token OPTION
 %token ORTHOGRAPHIC
 %token PERSPECTIVE
 %token PIXELFILTER
@@ -462,6 +466,29 @@ reno_stmt
     RenoMaterial(name, params);
     params.Clear();
 }
+| OBJECTBEGIN STRING
+{
+    std::string handle($2);
+    handle = handle.substr(1, handle.length() - 2);
+    RenoObjectBegin(handle);
+}
+| OBJECTEND
+{
+    RenoObjectEnd();
+}
+| OBJECTINSTANCE STRING
+{
+    std::string handle($2);
+    handle = handle.substr(1, handle.length() - 2);
+    RenoObjectInstance(handle);
+}
+| OPTION STRING paramlist
+{
+    std::string name($2);
+    name = name.substr(1, name.length() - 2);
+    RenoOption(name, params);
+    params.Clear();
+}
 | ORTHOGRAPHIC NUM NUM
 {
     RenoOrthographic($2, $3);
@@ -0,0 +1,148 @@
+#include "renoster/lightbounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "renoster/mathutil.h"
+
+namespace renoster {
+
+namespace {
+
+/// Cosine of max(0, a - b), given the sines and cosines of a and b
+float CosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB) {
+        return 1.f;
+    }
+    return cosA * cosB + sinA * sinB;
+}
+
+/// Sine of max(0, a - b), given the sines and cosines of a and b
+float SinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+    if (cosA > cosB) {
+        return 0.f;
+    }
+    return sinA * cosB - cosA * sinB;
+}
+
+/// Rotates v by theta around the unit axis (Rodrigues' formula)
+Vector3f Rotate(const Vector3f & v, const Vector3f & axis, float theta)
+{
+    float cosTheta = std::cos(theta);
+    float sinTheta = std::sin(theta);
+    return v * cosTheta + Cross(axis, v) * sinTheta +
+           axis * (Dot(axis, v) * (1.f - cosTheta));
+}
+
+}  // anonymous namespace
+
+DirectionCone Union(const DirectionCone & a, const DirectionCone & b)
+{
+    if (a.IsEmpty()) {
+        return b;
+    }
+    if (b.IsEmpty()) {
+        return a;
+    }
+
+    // Keep a cone that contains the other one
+    float thetaA = SafeAcos(a.cosTheta);
+    float thetaB = SafeAcos(b.cosTheta);
+    float thetaD = SafeAcos(Dot(a.w, b.w));
+    if (std::min(thetaD + thetaB, Pi) <= thetaA) {
+        return a;
+    }
+    if (std::min(thetaD + thetaA, Pi) <= thetaB) {
+        return b;
+    }
+
+    // Otherwise the cone spans from the far side of a to the far side of b
+    float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+    if (thetaO >= Pi) {
+        return DirectionCone::EntireSphere();
+    }
+
+    Vector3f axis = Cross(a.w, b.w);
+    if (LengthSquared(axis) == 0.f) {
+        return DirectionCone::EntireSphere();
+    }
+    Vector3f w = Rotate(a.w, Normalize(axis), thetaO - thetaA);
+    return DirectionCone(w, std::cos(thetaO));
+}
+
+float LightBounds::Importance(const Point3f & p, const Normal3f & n) const
+{
+    // Clamp the distance to the bounds, the lights may be anywhere inside
+    Point3f pc = bounds.Center();
+    float dist2 = LengthSquared(p - pc);
+    float d2 = std::max(dist2, 0.5f * Length(bounds.Diagonal()));
+
+    // Angle between w and the direction to p
+    Vector3f wi = dist2 > 0.f ? (p - pc) / std::sqrt(dist2)
+                              : Vector3f(0.f, 0.f, 1.f);
+    float cosThetaW = Dot(w, wi);
+    if (twoSided) {
+        cosThetaW = std::abs(cosThetaW);
+    }
+    float sinThetaW = SafeSqrt(1.f - cosThetaW * cosThetaW);
+
+    // Half angle of the cone of directions from p to the bounding sphere
+    float radius2 = 0.25f * LengthSquared(bounds.Diagonal());
+    float cosThetaB = -1.f;
+    if (dist2 > radius2) {
+        cosThetaB = SafeSqrt(1.f - radius2 / dist2);
+    }
+    float sinThetaB = SafeSqrt(1.f - cosThetaB * cosThetaB);
+
+    // Smallest angle between a normal in the cone and the direction to p.
+    // The lights do not reach p if it exceeds the emission angle.
+    float sinThetaO = SafeSqrt(1.f - cosThetaO * cosThetaO);
+    float cosThetaX = CosSubClamped(sinThetaW, cosThetaW, sinThetaO,
+                                    cosThetaO);
+    float sinThetaX = SinSubClamped(sinThetaW, cosThetaW, sinThetaO,
+                                    cosThetaO);
+    float cosThetaP = CosSubClamped(sinThetaX, cosThetaX, sinThetaB,
+                                    cosThetaB);
+    if (cosThetaP <= cosThetaE) {
+        return 0.f;
+    }
+
+    float importance = phi * cosThetaP / d2;
+
+    // Smallest angle between the normal at p and the bounds. Both sides
+    // of the surface are accepted, for transmission.
+    if (LengthSquared(n) > 0.f) {
+        float cosThetaI = std::abs(Dot(wi, n)) / Length(n);
+        float sinThetaI = SafeSqrt(1.f - cosThetaI * cosThetaI);
+        importance *= CosSubClamped(sinThetaI, cosThetaI, sinThetaB,
+                                    cosThetaB);
+    }
+
+    return std::max(importance, 0.f);
+}
+
+LightBounds Union(const LightBounds & a, const LightBounds & b)
+{
+    if (a.phi == 0.f) {
+        return b;
+    }
+    if (b.phi == 0.f) {
+        return a;
+    }
+
+    DirectionCone cone = Union(DirectionCone(a.w, a.cosThetaO),
+                               DirectionCone(b.w, b.cosThetaO));
+
+    LightBounds result;
+    result.bounds = Union(a.bounds, b.bounds);
+    result.w = cone.w;
+    result.phi = a.phi + b.phi;
+    result.cosThetaO = cone.cosTheta;
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    result.twoSided = a.twoSided || b.twoSided;
+    return result;
+}
+
+}  // namespace renoster
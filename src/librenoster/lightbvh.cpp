@@ -0,0 +1,267 @@
+#include "renoster/lightbvh.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "renoster/accel/binning.h"
+#include "renoster/mathutil.h"
+#include "renoster/parallel.h"
+#include "renoster/rng.h"
+
+namespace renoster {
+
+namespace {
+
+constexpr int NumBuckets = 12;
+
+/// Cost of a node with the light bounds b (Conty Estevez and Kulla 2018).
+/// The power is weighted by the solid angle measure of the emitted
+/// directions and by the surface area. Kr penalizes splits along the short
+/// dimensions of the parent bounds.
+float EvaluateCost(const LightBounds & b, const Bounds3f & bounds, int dim)
+{
+    float thetaO = SafeAcos(b.cosThetaO);
+    float thetaE = SafeAcos(b.cosThetaE);
+    float thetaW = std::min(thetaO + thetaE, Pi);
+    float sinThetaO = SafeSqrt(1.f - b.cosThetaO * b.cosThetaO);
+    float mOmega = TwoPi * (1.f - b.cosThetaO) +
+                   PiDivTwo * (2.f * thetaW * sinThetaO -
+                               std::cos(thetaO - 2.f * thetaW) -
+                               2.f * thetaO * sinThetaO + b.cosThetaO);
+
+    Vector3f d = bounds.Diagonal();
+    float kr = std::max(d.x(), std::max(d.y(), d.z())) / d[dim];
+    return b.phi * mOmega * kr * b.bounds.SurfaceArea();
+}
+
+}  // anonymous namespace
+
+LightBVH::LightBVH(const std::vector<Primitive *> & lights)
+    : _lightNodes(lights.size(), ZeroPowerLight)
+{
+    // Bound the lights in parallel, meshes go over all of their triangles
+    std::vector<BuildItem> items(lights.size());
+    std::vector<uint8_t> bounded(lights.size());
+    PrimitiveContext ctx;
+    ParallelFor(0, lights.size(), 64, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            bounded[i] = lights[i]->GetLightBounds(ctx, &items[i].bounds);
+            items[i].centroid = items[i].bounds.bounds.Center();
+            items[i].lightId = static_cast<int>(i);
+        }
+    });
+
+    // Lights that do not emit are never picked
+    size_t numItems = 0;
+    for (size_t i = 0; i < lights.size(); ++i) {
+        if (!bounded[i]) {
+            _lightNodes[i] = UnboundedLight;
+            _unboundedLights.push_back(static_cast<int>(i));
+        } else if (items[i].bounds.phi > 0.f) {
+            items[numItems++] = items[i];
+        }
+    }
+    items.resize(numItems);
+
+    if (!items.empty()) {
+        _nodes.resize(2 * items.size() - 1);
+        BuildRecursive(span<BuildItem>(items), 0, -1);
+    }
+}
+
+void LightBVH::BuildRecursive(span<BuildItem> items, int nodeIndex,
+                              int parent)
+{
+    Node & node = _nodes[nodeIndex];
+    node.parent = parent;
+
+    if (items.size() == 1) {
+        node.bounds = items[0].bounds;
+        node.index = items[0].lightId;
+        node.isLeaf = true;
+        _lightNodes[items[0].lightId] = nodeIndex;
+        return;
+    }
+
+    Bounds3f bounds;
+    Bounds3f centBounds;
+    for (const BuildItem & item : items) {
+        bounds.ExpandBy(item.bounds.bounds);
+        centBounds.ExpandBy(item.centroid);
+    }
+
+    // Find the cheapest split between buckets of the centroids
+    auto GetBucket = [&centBounds](const BuildItem & item, int dim) {
+        float extent = centBounds.max()[dim] - centBounds.min()[dim];
+        int bucket = static_cast<int>(
+                NumBuckets * (item.centroid[dim] - centBounds.min()[dim]) /
+                extent);
+        return std::min(bucket, NumBuckets - 1);
+    };
+
+    float minCost = Infinity;
+    int minDim = -1;
+    int minBucket = -1;
+    for (int dim = 0; dim < 3; ++dim) {
+        if (centBounds.max()[dim] == centBounds.min()[dim]) {
+            continue;
+        }
+
+        LightBounds buckets[NumBuckets];
+        for (const BuildItem & item : items) {
+            int b = GetBucket(item, dim);
+            buckets[b] = Union(buckets[b], item.bounds);
+        }
+
+        // Bounds of the buckets above every split
+        LightBounds above[NumBuckets];
+        above[NumBuckets - 1] = buckets[NumBuckets - 1];
+        for (int b = NumBuckets - 2; b > 0; --b) {
+            above[b] = Union(buckets[b], above[b + 1]);
+        }
+
+        LightBounds below;
+        for (int b = 0; b < NumBuckets - 1; ++b) {
+            below = Union(below, buckets[b]);
+            if (below.phi == 0.f || above[b + 1].phi == 0.f) {
+                continue;
+            }
+
+            float cost = EvaluateCost(below, bounds, dim) +
+                         EvaluateCost(above[b + 1], bounds, dim);
+            if (cost < minCost) {
+                minCost = cost;
+                minDim = dim;
+                minBucket = b;
+            }
+        }
+    }
+
+    // Split in the middle if all centroids coincide
+    BuildItem * mid;
+    if (minDim == -1) {
+        mid = items.begin() + items.size() / 2;
+    } else {
+        mid = ParallelPartition(
+                items.begin(), items.end(), [&](const BuildItem & item) {
+            return GetBucket(item, minDim) <= minBucket;
+        }, ParallelBuildThreshold);
+    }
+
+    span<BuildItem> leftItems(items.begin(), mid);
+    span<BuildItem> rightItems(mid, items.end());
+    int left = nodeIndex + 1;
+    int right = nodeIndex + 2 * static_cast<int>(leftItems.size());
+    node.index = right;
+    node.isLeaf = false;
+
+    // Large subtrees are built in parallel, they fill disjoint nodes
+    TaskGroup group;
+    if (static_cast<size_t>(leftItems.size()) > ParallelBuildThreshold) {
+        group.Spawn([this, leftItems, left, nodeIndex]() {
+            BuildRecursive(leftItems, left, nodeIndex);
+        });
+    } else {
+        BuildRecursive(leftItems, left, nodeIndex);
+    }
+    BuildRecursive(rightItems, right, nodeIndex);
+    group.Wait();
+
+    node.bounds = Union(_nodes[left].bounds, _nodes[right].bounds);
+}
+
+float LightBVH::GetTreeProbability() const
+{
+    if (_nodes.empty()) {
+        return 0.f;
+    }
+    return 1.f / (1.f + _unboundedLights.size());
+}
+
+int LightBVH::Sample(const ShadingPoint & ref, float u, float * pmf) const
+{
+    if (_nodes.empty() && _unboundedLights.empty()) {
+        *pmf = 0.f;
+        return -1;
+    }
+
+    // Pick the tree or one of the unbounded lights
+    float pTree = GetTreeProbability();
+    if (u >= pTree) {
+        float pUnbounded = 1.f - pTree;
+        int numUnbounded = static_cast<int>(_unboundedLights.size());
+        int i = static_cast<int>((u - pTree) / pUnbounded * numUnbounded);
+        *pmf = pUnbounded / numUnbounded;
+        return _unboundedLights[std::min(i, numUnbounded - 1)];
+    }
+    u = std::min(u / pTree, OneMinusEpsilon);
+
+    // Descend to a leaf, picking the children by their importance
+    float p = pTree;
+    int nodeIndex = 0;
+    while (!_nodes[nodeIndex].isLeaf) {
+        const Node & node = _nodes[nodeIndex];
+        float c0 = _nodes[nodeIndex + 1].bounds.Importance(ref.p, ref.ns);
+        float c1 = _nodes[node.index].bounds.Importance(ref.p, ref.ns);
+        if (c0 == 0.f && c1 == 0.f) {
+            *pmf = 0.f;
+            return -1;
+        }
+
+        float p0 = c0 / (c0 + c1);
+        if (u < p0) {
+            nodeIndex = nodeIndex + 1;
+            u = std::min(u / p0, OneMinusEpsilon);
+            p *= p0;
+        } else {
+            nodeIndex = node.index;
+            u = std::min((u - p0) / (1.f - p0), OneMinusEpsilon);
+            p *= 1.f - p0;
+        }
+    }
+
+    // A single light at the root is the only one that was not checked
+    if (nodeIndex == 0 && _nodes[0].bounds.Importance(ref.p, ref.ns) == 0.f) {
+        *pmf = 0.f;
+        return -1;
+    }
+
+    *pmf = p;
+    return _nodes[nodeIndex].index;
+}
+
+float LightBVH::Pmf(const ShadingPoint & ref, int lightId) const
+{
+    int nodeIndex = _lightNodes[lightId];
+    if (nodeIndex == ZeroPowerLight) {
+        return 0.f;
+    }
+
+    float pTree = GetTreeProbability();
+    if (nodeIndex == UnboundedLight) {
+        return (1.f - pTree) / _unboundedLights.size();
+    }
+
+    if (nodeIndex == 0) {
+        return _nodes[0].bounds.Importance(ref.p, ref.ns) > 0.f ? pTree : 0.f;
+    }
+
+    // Multiply the probabilities of the choices from the leaf to the root
+    float pmf = pTree;
+    while (nodeIndex != 0) {
+        int parent = _nodes[nodeIndex].parent;
+        float c0 = _nodes[parent + 1].bounds.Importance(ref.p, ref.ns);
+        float c1 = _nodes[_nodes[parent].index].bounds.Importance(ref.p,
+                                                                  ref.ns);
+        if (c0 == 0.f && c1 == 0.f) {
+            return 0.f;
+        }
+
+        float p0 = c0 / (c0 + c1);
+        pmf *= nodeIndex == parent + 1 ? p0 : 1.f - p0;
+        nodeIndex = parent;
+    }
+    return pmf;
+}
+
+}  // namespace renoster
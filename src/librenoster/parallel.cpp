@@ -0,0 +1,267 @@
+#include "renoster/parallel.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace renoster {
+
+struct Task {
+    std::function<void()> func;
+    TaskGroup * group;
+};
+
+/// TaskQueue is the deque of a single thread. The owner pushes and pops at
+/// the back, other threads steal the oldest (and usually largest) tasks
+/// from the front.
+class TaskQueue {
+public:
+    void Push(std::unique_ptr<Task> task) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _tasks.push_back(std::move(task));
+    }
+
+    std::unique_ptr<Task> Pop() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_tasks.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<Task> task = std::move(_tasks.back());
+        _tasks.pop_back();
+        return task;
+    }
+
+    std::unique_ptr<Task> Steal() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_tasks.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<Task> task = std::move(_tasks.front());
+        _tasks.pop_front();
+        return task;
+    }
+
+private:
+    std::mutex _mutex;
+    std::deque<std::unique_ptr<Task>> _tasks;
+};
+
+class TaskScheduler {
+public:
+    explicit TaskScheduler(int numThreads);
+
+    ~TaskScheduler();
+
+    int NumThreads() const {
+        return static_cast<int>(_queues.size());
+    }
+
+    void Spawn(TaskGroup * group, std::function<void()> func);
+
+    void Wait(TaskGroup * group);
+
+private:
+    void WorkerThread(int index);
+
+    std::unique_ptr<Task> FindTask(int index);
+
+    void Execute(std::unique_ptr<Task> task);
+
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    /// Number of tasks in all queues, used to put idle workers to sleep
+    std::atomic<int> _numQueued{0};
+    std::mutex _sleepMutex;
+    std::condition_variable _sleepCondition;
+    bool _shutdown = false;
+};
+
+static thread_local int threadIndex = 0;
+static std::unique_ptr<TaskScheduler> scheduler;
+
+TaskScheduler::TaskScheduler(int numThreads)
+{
+    for (int i = 0; i < numThreads; ++i) {
+        _queues.push_back(std::make_unique<TaskQueue>());
+    }
+
+    // Thread 0 is the thread that created the scheduler
+    for (int i = 1; i < numThreads; ++i) {
+        _threads.emplace_back(&TaskScheduler::WorkerThread, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _shutdown = true;
+    }
+    _sleepCondition.notify_all();
+
+    for (std::thread & thread : _threads) {
+        thread.join();
+    }
+}
+
+void TaskScheduler::Spawn(TaskGroup * group, std::function<void()> func)
+{
+    group->_numPending.fetch_add(1, std::memory_order_relaxed);
+
+    auto task = std::make_unique<Task>();
+    task->func = std::move(func);
+    task->group = group;
+    _queues[threadIndex]->Push(std::move(task));
+    _numQueued.fetch_add(1);
+
+    // Taking the lock makes sure a worker that is about to sleep sees the
+    // new task before it waits
+    { std::lock_guard<std::mutex> lock(_sleepMutex); }
+    _sleepCondition.notify_one();
+}
+
+void TaskScheduler::Wait(TaskGroup * group)
+{
+    while (group->_numPending.load(std::memory_order_acquire) > 0) {
+        if (std::unique_ptr<Task> task = FindTask(threadIndex)) {
+            Execute(std::move(task));
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskScheduler::WorkerThread(int index)
+{
+    threadIndex = index;
+
+    while (true) {
+        if (std::unique_ptr<Task> task = FindTask(index)) {
+            Execute(std::move(task));
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleepCondition.wait(lock, [this]() {
+            return _shutdown || _numQueued.load() > 0;
+        });
+        if (_shutdown) {
+            return;
+        }
+    }
+}
+
+std::unique_ptr<Task> TaskScheduler::FindTask(int index)
+{
+    if (_numQueued.load() == 0) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Task> task = _queues[index]->Pop();
+
+    // Steal from the other threads, starting at the next one
+    int numThreads = NumThreads();
+    for (int i = 1; !task && i < numThreads; ++i) {
+        task = _queues[(index + i) % numThreads]->Steal();
+    }
+
+    if (task) {
+        _numQueued.fetch_sub(1);
+    }
+    return task;
+}
+
+void TaskScheduler::Execute(std::unique_ptr<Task> task)
+{
+    task->func();
+    task->group->_numPending.fetch_sub(1, std::memory_order_release);
+}
+
+void ParallelInit(int numThreads)
+{
+    numThreads = std::max(1, numThreads);
+    if (NumThreads() == numThreads) {
+        return;
+    }
+
+    ParallelCleanup();
+
+    // A single thread runs every task inline
+    if (numThreads > 1) {
+        scheduler = std::make_unique<TaskScheduler>(numThreads);
+    }
+}
+
+void ParallelCleanup()
+{
+    scheduler.reset();
+}
+
+int NumThreads()
+{
+    return scheduler ? scheduler->NumThreads() : 1;
+}
+
+int ThreadIndex()
+{
+    return threadIndex;
+}
+
+void TaskGroup::Spawn(std::function<void()> func)
+{
+    if (scheduler) {
+        scheduler->Spawn(this, std::move(func));
+    } else {
+        func();
+    }
+}
+
+void TaskGroup::Wait()
+{
+    if (scheduler) {
+        scheduler->Wait(this);
+    }
+}
+
+static void ParallelForRange(
+        TaskGroup & group, int64_t begin, int64_t end, int64_t grainSize,
+        const std::function<void(int64_t, int64_t)> & func)
+{
+    // Hand out the upper halves and keep splitting the lower half
+    while (end - begin > grainSize) {
+        int64_t mid = begin + (end - begin) / 2;
+        group.Spawn([&group, mid, end, grainSize, &func]() {
+            ParallelForRange(group, mid, end, grainSize, func);
+        });
+        end = mid;
+    }
+
+    func(begin, end);
+}
+
+void ParallelFor(int64_t begin, int64_t end, int64_t grainSize,
+                 const std::function<void(int64_t, int64_t)> & func)
+{
+    if (begin >= end) {
+        return;
+    }
+    grainSize = std::max<int64_t>(1, grainSize);
+
+    if (!scheduler) {
+        for (int64_t i = begin; i < end; i += grainSize) {
+            func(i, std::min(end, i + grainSize));
+        }
+        return;
+    }
+
+    TaskGroup group;
+    ParallelForRange(group, begin, end, grainSize, func);
+    group.Wait();
+}
+
+}  // namespace renoster
@@ -290,6 +290,7 @@ ParameterList::ParameterList(const ParameterList & params)
 ParameterList & ParameterList::operator=(const ParameterList & params)
 {
     _impl = std::make_unique<Impl>(*params._impl);
+    return *this;
 }
 
 void ParameterList::Clear()
@@ -1,7 +1,60 @@
 #include "renoster/primitive.h"
 
+#include <optional>
+
 namespace renoster {
 
+namespace {
+
+/// Returns the context of a primitive placed by ctx. Primitives of the
+/// scene and of objects get an identity context, so they pass their own
+/// context without any matrix products. Otherwise the transforms are
+/// composed into composed.
+const GeometryContext & ComposeContext(
+        const PrimitiveContext & ctx, const GeometryContext & local,
+        std::optional<GeometryContext> * composed)
+{
+    if (ctx.PrimitiveToWorld.IsIdentity()) {
+        return local;
+    }
+    composed->emplace(local.WorldToObject * ctx.WorldToPrimitive,
+                      ctx.PrimitiveToWorld * local.ObjectToWorld);
+    return **composed;
+}
+
+const LightContext & ComposeContext(
+        const PrimitiveContext & ctx, const LightContext & local,
+        std::optional<LightContext> * composed)
+{
+    if (ctx.PrimitiveToWorld.IsIdentity()) {
+        return local;
+    }
+    composed->emplace(local.WorldToLight * ctx.WorldToPrimitive,
+                      ctx.PrimitiveToWorld * local.LightToWorld);
+    return **composed;
+}
+
+const PrimitiveContext & ComposeContext(
+        const PrimitiveContext & ctx, const PrimitiveContext & local,
+        std::optional<PrimitiveContext> * composed)
+{
+    if (ctx.PrimitiveToWorld.IsIdentity()) {
+        return local;
+    }
+    composed->emplace(local.WorldToPrimitive * ctx.WorldToPrimitive,
+                      ctx.PrimitiveToWorld * local.PrimitiveToWorld);
+    return **composed;
+}
+
+/// Context of the primitives of an object, in the space of the object
+const PrimitiveContext & IdentityContext()
+{
+    static const PrimitiveContext identity;
+    return identity;
+}
+
+}  // anonymous namespace
+
 Primitive::~Primitive() = default;
 
 bool Primitive::Intersect(const PrimitiveContext &, const Ray3f &,
@@ -60,6 +113,12 @@ Bounds3f Primitive::GetWorldBounds(const PrimitiveContext & ctx) const
     return Bounds3f();
 }
 
+bool Primitive::GetLightBounds(const PrimitiveContext & ctx,
+                               LightBounds * bounds) const
+{
+    return false;
+}
+
 GeometricPrimitive::GeometricPrimitive(
         const std::shared_ptr<Geometry> & geometry,
         const std::shared_ptr<GeometryLight> & light,
@@ -69,36 +128,40 @@ GeometricPrimitive::GeometricPrimitive(
     : _geometry(geometry),
     _light(light),
     _material(material),
-    _WorldToGeometry(WorldToGeometry),
-    _GeometryToWorld(GeometryToWorld)
+    _geometryCtx(WorldToGeometry, GeometryToWorld),
+    _lightCtx(WorldToGeometry, GeometryToWorld)
 {
 }
 
 bool GeometricPrimitive::Intersect(const PrimitiveContext & pCtx,
                                    const Ray3f & ray, ShadingPoint * sp) const
 {
-    GeometryContext gCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                         pCtx.PrimitiveToWorld * _GeometryToWorld);
+    std::optional<GeometryContext> composed;
+    const GeometryContext & gCtx = ComposeContext(pCtx, _geometryCtx,
+                                                  &composed);
     if (!_geometry->Intersect(gCtx, ray, sp)) {
         return false;
     }
     sp->primitive = this;
+    sp->instance = nullptr;
     return true;
 }
 
 bool GeometricPrimitive::Occluded(const PrimitiveContext & pCtx,
                                   const Ray3f & ray) const
 {
-    GeometryContext gCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                         pCtx.PrimitiveToWorld * _GeometryToWorld);
+    std::optional<GeometryContext> composed;
+    const GeometryContext & gCtx = ComposeContext(pCtx, _geometryCtx,
+                                                  &composed);
     return _geometry->Occluded(gCtx, ray);
 }
 
 void GeometricPrimitive::ComputeShadingInfo(const PrimitiveContext & pCtx,
                                             ShadingPoint * sp) const
 {
-    GeometryContext gCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                         pCtx.PrimitiveToWorld * _GeometryToWorld);
+    std::optional<GeometryContext> composed;
+    const GeometryContext & gCtx = ComposeContext(pCtx, _geometryCtx,
+                                                  &composed);
     return _geometry->ComputeShadingInfo(gCtx, sp);
 }
 
@@ -118,8 +181,9 @@ Color GeometricPrimitive::SampleDirect(const PrimitiveContext & pCtx,
                                       float * pdf) const
 {
     if (_light) {
-        LightContext lCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                          pCtx.PrimitiveToWorld * _GeometryToWorld);
+        std::optional<LightContext> composed;
+        const LightContext & lCtx = ComposeContext(pCtx, _lightCtx,
+                                                   &composed);
         pos->primitive = this;
         return _light->SampleDirect(lCtx, sampler, ref, pos, pdf);
     } else {
@@ -134,8 +198,9 @@ Color GeometricPrimitive::EvaluateDirect(const PrimitiveContext & pCtx,
                                          float * pdf) const
 {
     if (_light) {
-        LightContext lCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                          pCtx.PrimitiveToWorld * _GeometryToWorld);
+        std::optional<LightContext> composed;
+        const LightContext & lCtx = ComposeContext(pCtx, _lightCtx,
+                                                   &composed);
         return _light->EvaluateDirect(lCtx, ref, pos, pdf);
     } else {
         *pdf = 0.f;
@@ -148,8 +213,9 @@ Color GeometricPrimitive::SampleEmission(const PrimitiveContext & pCtx,
                                          float * pdf) const
 {
     if (_light) {
-        LightContext lCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                          pCtx.PrimitiveToWorld * _GeometryToWorld);
+        std::optional<LightContext> composed;
+        const LightContext & lCtx = ComposeContext(pCtx, _lightCtx,
+                                                   &composed);
         sp->primitive = this;
         return _light->SampleEmission(lCtx, sampler, sp, pdf);
     } else {
@@ -163,8 +229,9 @@ Color GeometricPrimitive::EvaluateEmission(const PrimitiveContext & pCtx,
                                            float * pdf) const
 {
     if (_light) {
-        LightContext lCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                          pCtx.PrimitiveToWorld * _GeometryToWorld);
+        std::optional<LightContext> composed;
+        const LightContext & lCtx = ComposeContext(pCtx, _lightCtx,
+                                                   &composed);
         return _light->EvaluateEmission(lCtx, sp, pdf);
     } else {
         *pdf = 0.f;
@@ -174,17 +241,30 @@ Color GeometricPrimitive::EvaluateEmission(const PrimitiveContext & pCtx,
 
 Bounds3f GeometricPrimitive::GetWorldBounds(const PrimitiveContext & pCtx) const
 {
-    GeometryContext gCtx(_WorldToGeometry * pCtx.WorldToPrimitive,
-                         pCtx.PrimitiveToWorld * _GeometryToWorld);
+    std::optional<GeometryContext> composed;
+    const GeometryContext & gCtx = ComposeContext(pCtx, _geometryCtx,
+                                                  &composed);
     return _geometry->GetWorldBounds(gCtx);
 }
 
+bool GeometricPrimitive::GetLightBounds(const PrimitiveContext & pCtx,
+                                        LightBounds * bounds) const
+{
+    if (_light) {
+        std::optional<LightContext> composed;
+        const LightContext & lCtx = ComposeContext(pCtx, _lightCtx,
+                                                   &composed);
+        return _light->GetBounds(lCtx, bounds);
+    } else {
+        return false;
+    }
+}
+
 LightPrimitive::LightPrimitive(const std::shared_ptr<Light> & light,
                                const Transform & WorldToLight,
                                const Transform & LightToWorld)
     : _light(light),
-    _WorldToLight(WorldToLight),
-    _LightToWorld(LightToWorld)
+    _ctx(WorldToLight, LightToWorld)
 {
 }
 
@@ -192,8 +272,8 @@ Color LightPrimitive::SampleDirect(const PrimitiveContext & pCtx,
                                   Sampler & sampler, const ShadingPoint & ref,
                                   ShadingPoint * pos, float * pdf) const
 {
-    LightContext lCtx(_WorldToLight * pCtx.WorldToPrimitive,
-                      pCtx.PrimitiveToWorld * _LightToWorld);
+    std::optional<LightContext> composed;
+    const LightContext & lCtx = ComposeContext(pCtx, _ctx, &composed);
     pos->primitive = this;
     return _light->SampleDirect(lCtx, sampler, ref, pos, pdf);
 }
@@ -203,8 +283,8 @@ Color LightPrimitive::EvaluateDirect(const PrimitiveContext & pCtx,
                                      const ShadingPoint & pos,
                                      float * pdf) const
 {
-    LightContext lCtx(_WorldToLight * pCtx.WorldToPrimitive,
-                      pCtx.PrimitiveToWorld * _LightToWorld);
+    std::optional<LightContext> composed;
+    const LightContext & lCtx = ComposeContext(pCtx, _ctx, &composed);
     return _light->EvaluateDirect(lCtx, ref, pos, pdf);
 }
 
@@ -212,8 +292,8 @@ Color LightPrimitive::SampleEmission(const PrimitiveContext & pCtx,
                                      Sampler & sampler, ShadingPoint * sp,
                                      float * pdf) const
 {
-    LightContext lCtx(_WorldToLight * pCtx.WorldToPrimitive,
-                      pCtx.PrimitiveToWorld * _LightToWorld);
+    std::optional<LightContext> composed;
+    const LightContext & lCtx = ComposeContext(pCtx, _ctx, &composed);
     sp->primitive = this;
     return _light->SampleEmission(lCtx, sampler, sp, pdf);
 }
@@ -222,18 +302,25 @@ Color LightPrimitive::EvaluateEmission(const PrimitiveContext & pCtx,
                                        const ShadingPoint & sp,
                                        float * pdf) const
 {
-    LightContext lCtx(_WorldToLight * pCtx.WorldToPrimitive,
-                      pCtx.PrimitiveToWorld * _LightToWorld);
+    std::optional<LightContext> composed;
+    const LightContext & lCtx = ComposeContext(pCtx, _ctx, &composed);
     return _light->EvaluateEmission(lCtx, sp, pdf);
 }
 
+bool LightPrimitive::GetLightBounds(const PrimitiveContext & pCtx,
+                                    LightBounds * bounds) const
+{
+    std::optional<LightContext> composed;
+    const LightContext & lCtx = ComposeContext(pCtx, _ctx, &composed);
+    return _light->GetBounds(lCtx, bounds);
+}
+
 TransformedPrimitive::TransformedPrimitive(
         const std::shared_ptr<Primitive> & primitive,
         const Transform & WorldToPrimitive,
         const Transform & PrimitiveToWorld)
     : _primitive(primitive),
-    _WorldToPrimitive(WorldToPrimitive),
-    _PrimitiveToWorld(PrimitiveToWorld)
+    _ctx(WorldToPrimitive, PrimitiveToWorld)
 {
 }
 
@@ -241,38 +328,50 @@ bool TransformedPrimitive::Intersect(const PrimitiveContext & ctx,
                                      const Ray3f & ray,
                                      ShadingPoint * sp) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    if (!_primitive->Intersect(newCtx, ray, sp)) {
+    // Intersect the primitives in object space, so they do not compose
+    // their transforms with the instance. The ray keeps its parametric
+    // distances, so only the hit is transformed to world space.
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    Ray3f objRay = newCtx.WorldToPrimitive(ray);
+    if (!_primitive->Intersect(IdentityContext(), objRay, sp)) {
         return false;
     }
-    sp->primitive = this;
+    ray.tMax() = objRay.tMax();
+    sp->p = newCtx.PrimitiveToWorld(sp->p);
+    sp->wo = -ray.d();
+    sp->ng = Normalize(newCtx.PrimitiveToWorld(sp->ng));
+    sp->ns = Normalize(newCtx.PrimitiveToWorld(sp->ns));
+
+    // Keep the hit primitive, the instance supplies its transforms
+    sp->instance = this;
     return true;
 }
 
 bool TransformedPrimitive::Occluded(const PrimitiveContext & ctx,
                                     const Ray3f & ray) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    return _primitive->Occluded(newCtx, ray);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    return _primitive->Occluded(IdentityContext(),
+                                newCtx.WorldToPrimitive(ray));
 }
 
 void TransformedPrimitive::ComputeShadingInfo(const PrimitiveContext & ctx,
                                               ShadingPoint * sp) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    return _primitive->ComputeShadingInfo(newCtx, sp);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    return sp->primitive->ComputeShadingInfo(newCtx, sp);
 }
 
 void TransformedPrimitive::ComputeScatteringFunctions(
         const PrimitiveContext & ctx, Allocator & alloc,
         ShadingPoint * sp) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    _primitive->ComputeScatteringFunctions(newCtx, alloc, sp);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    sp->primitive->ComputeScatteringFunctions(newCtx, alloc, sp);
 }
 
 Color TransformedPrimitive::SampleDirect(const PrimitiveContext & ctx,
@@ -281,8 +380,8 @@ Color TransformedPrimitive::SampleDirect(const PrimitiveContext & ctx,
                                          ShadingPoint * pos,
                                          float * pdf) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
     Color L = _primitive->SampleDirect(newCtx, sampler, ref, pos, pdf);
     pos->primitive = this;
     return L;
@@ -293,8 +392,8 @@ Color TransformedPrimitive::EvaluateDirect(const PrimitiveContext & ctx,
                                            const ShadingPoint & pos,
                                            float * pdf) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
     return _primitive->EvaluateDirect(newCtx, ref, pos, pdf);
 }
 
@@ -303,9 +402,9 @@ Color TransformedPrimitive::SampleEmission(const PrimitiveContext & ctx,
                                            ShadingPoint * sp,
                                            float * pdf) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    Color L = _primitive->SampleEmission(ctx, sampler, sp, pdf);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    Color L = _primitive->SampleEmission(newCtx, sampler, sp, pdf);
     sp->primitive = this;
     return L;
 }
@@ -314,16 +413,24 @@ Color TransformedPrimitive::EvaluateEmission(const PrimitiveContext & ctx,
                                              const ShadingPoint & sp,
                                              float * pdf) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
-    return _primitive->EvaluateEmission(ctx, sp, pdf);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    return _primitive->EvaluateEmission(newCtx, sp, pdf);
 }
 
 Bounds3f TransformedPrimitive::GetWorldBounds(const PrimitiveContext & ctx) const
 {
-    PrimitiveContext newCtx(_WorldToPrimitive * ctx.WorldToPrimitive,
-                            ctx.PrimitiveToWorld * _PrimitiveToWorld);
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
     return _primitive->GetWorldBounds(newCtx);
 }
 
+bool TransformedPrimitive::GetLightBounds(const PrimitiveContext & ctx,
+                                          LightBounds * bounds) const
+{
+    std::optional<PrimitiveContext> composed;
+    const PrimitiveContext & newCtx = ComposeContext(ctx, _ctx, &composed);
+    return _primitive->GetLightBounds(newCtx, bounds);
+}
+
 }  // namespace renoster
@@ -1,40 +1,57 @@
 #include "renoster/renderer.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
 #include <iostream>
-#include "renoster/log.h"
-
 #include <memory>
-#include <thread>
 #include <vector>
 
 #include "renoster/camera.h"
 #include "renoster/filmaccumulator.h"
+#include "renoster/log.h"
+#include "renoster/parallel.h"
+#include "renoster/stats.h"
+#include "renoster/util/curve.h"
 
 namespace renoster {
 
 Renderer::Renderer(Camera * camera, Film * film, Integrator * integrator,
-                   Sampler * sampler)
+                   Sampler * sampler, const RenderSettings & settings)
     : _camera(camera),
     _film(film),
     _integrator(integrator),
-    _sampler(sampler)
+    _sampler(sampler),
+    _settings(settings)
 {
 }
 
-void Renderer::RenderThread(const Scene & scene, int threadId)
+bool Renderer::RenderTile(const Scene & scene, int sampleBegin,
+                          int sampleEnd, FilmAccumulator & accum,
+                          Allocator & alloc)
 {
-    FilmAccumulator accum;
-    Allocator alloc;
-
-    while(auto tile = _film->GetNextTile()) {
+    if (auto tile = _film->GetNextTile()) {
         Bounds2i tileBounds = tile->GetSampleBounds();
 
-        int tileId = tile->GetTileId();
-        std::unique_ptr<Sampler> tileSampler = _sampler->Clone(tileId);
+        // The samples only depend on the pixel and the sample index, so
+        // they do not change with the tiles or the passes
+        std::unique_ptr<Sampler> tileSampler = _sampler->Clone();
+        tileSampler->SetSampleRange(sampleBegin, sampleEnd);
 
         IntegratorContext ctx(scene, *tileSampler, alloc);
 
-        for (Point2i pixel : tileBounds) {
+        // Visit the pixels in Morton order over square blocks of the tile,
+        // so consecutive pixels are neighbours in both directions
+        Vector2i tileExtent = tileBounds.Diagonal();
+        uint32_t tileWidth = static_cast<uint32_t>(tileExtent.x());
+        uint32_t tileHeight = static_cast<uint32_t>(tileExtent.y());
+        VisitMorton2(0, 0, tileWidth, tileHeight, [&](uint32_t x, uint32_t y) {
+            Point2i pixel = tileBounds.min() + Vector2i(x, y);
+            if (_film->IsConverged(pixel)) {
+                return;
+            }
+
             tileSampler->StartPixel(pixel);
 
             while(tileSampler->StartNextSample()) {
@@ -49,6 +66,7 @@ void Renderer::RenderThread(const Scene & scene, int threadId)
                 float time = tileSampler->Get1D();
                 float weight = _camera->GenerateRay(*tileSampler, pScreen,
                                                     time, &ray);
+                RENO_STAT_ADD(Stat::kCameraRays, 1);
 
                 // Include film and camera sample weights
                 Color result;
@@ -65,23 +83,164 @@ void Renderer::RenderThread(const Scene & scene, int threadId)
 
                 alloc.Reset();
             }
-        }
+        });
+
+        // The blocks are kept for reuse, so they hold the peak usage
+        RENO_STAT_MAX(Stat::kAllocatorPeakBytes, alloc.GetNumBytes());
 
         _film->MergeFilmTile(std::move(tile));
+        return true;
     }
+    return false;
 }
 
 void Renderer::Render(const Scene & scene)
 {
-    int numThreads = 1;//8;
-    
-    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+
+    // Every thread owns an accumulator and an allocator. Tiles get their
+    // own sampler, and the tile generator and the film pixels are guarded
+    // by the film.
+    int numThreads = NumThreads();
+    std::vector<FilmAccumulator> accums(numThreads);
+    std::vector<std::unique_ptr<Allocator>> allocs;
     for (int i = 0; i < numThreads; ++i) {
-        threads.emplace_back(&Renderer::RenderThread, this, std::ref(scene), i);
+        allocs.push_back(std::make_unique<Allocator>());
     }
-    for (int i = 0; i < numThreads; ++i) {
-        threads[i].join();
+
+    int spp = _sampler->GetSamplesPerPixel();
+    bool checkpoint = !_settings.checkpointFilename.empty();
+    int samplesPerPass = _settings.samplesPerPass;
+    bool timedPasses = false;
+    if (samplesPerPass <= 0) {
+        // Adaptive sampling checks the pixels between the passes, and a
+        // time limit is checked with the finest passes. A single pass
+        // could not be checkpointed, so the first pass times a sample and
+        // the next ones last until a checkpoint is due.
+        if (_film->IsAdaptive()) {
+            samplesPerPass = _film->GetAdaptiveMinSamples();
+        } else if (_settings.timeLimit > 0.f) {
+            samplesPerPass = 1;
+        } else if (checkpoint) {
+            samplesPerPass = 1;
+            timedPasses = true;
+        } else {
+            samplesPerPass = spp;
+        }
+    }
+    samplesPerPass = std::max(1, std::min(samplesPerPass, spp));
+
+    // Continue after the samples stored in the checkpoint. The samples
+    // only depend on their index, so the remaining passes sample as if the
+    // render had not been interrupted.
+    CheckpointProgress progress;
+    progress.samplesPerPixel = spp;
+    if (_settings.resume && checkpoint &&
+        _film->ReadCheckpoint(_settings.checkpointFilename, &progress)) {
+        progress.numSamples = std::min(progress.numSamples, spp);
+        Info("Resuming after %d of %d samples per pixel",
+             progress.numSamples, spp);
+    }
+    int firstSample = progress.numSamples;
+    int firstPass = progress.numPasses;
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+
+    while (progress.numSamples < spp) {
+        int sampleBegin = progress.numSamples;
+        int sampleEnd = std::min(spp, sampleBegin + samplesPerPass);
+        bool finished = sampleEnd == spp;
+
+        // Every thread takes tiles until the film runs out of them
+        _film->StartPass(finished);
+        ParallelFor(0, numThreads, 1, [&](int64_t, int64_t) {
+            int threadIndex = ThreadIndex();
+            while (RenderTile(scene, sampleBegin, sampleEnd,
+                              accums[threadIndex], *allocs[threadIndex])) {
+            }
+        });
+
+        progress.numSamples = sampleEnd;
+        ++progress.numPasses;
+
+        // The film writes the final image itself
+        if (!finished && _settings.samplesPerPass > 0) {
+            _film->UpdateDisplay();
+        }
+        if (!finished && _film->IsAdaptive() &&
+            _film->UpdateConvergence() == 0) {
+            finished = true;
+        }
+
+        // Skip the next pass if it is expected to overrun the time limit
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - start;
+        double sampleTime = elapsed.count() / (sampleEnd - firstSample);
+        bool outOfTime = false;
+        if (!finished && _settings.timeLimit > 0.f) {
+            double passTime = sampleTime * samplesPerPass;
+            outOfTime = elapsed.count() + passTime > _settings.timeLimit;
+            if (outOfTime) {
+                Info("Stopped after %d of %d samples per pixel at the time "
+                     "limit", sampleEnd, spp);
+            }
+        }
+
+        // Checkpoint periodically, and when stopping so a later render can
+        // continue or write the image again
+        std::chrono::duration<double> sinceCheckpoint = now - lastCheckpoint;
+        if (checkpoint) {
+            if (finished || outOfTime) {
+                _film->WaitForCheckpoint();
+                _film->WriteCheckpoint(_settings.checkpointFilename,
+                                       progress);
+            } else if (sinceCheckpoint.count() >=
+                       _settings.checkpointInterval) {
+                _film->WriteCheckpoint(_settings.checkpointFilename,
+                                       progress);
+                lastCheckpoint = now;
+                sinceCheckpoint = std::chrono::duration<double>(0.0);
+            }
+        }
+        if (finished || outOfTime) {
+            break;
+        }
+
+        // Render until the next checkpoint is due
+        if (timedPasses) {
+            double untilCheckpoint =
+                    _settings.checkpointInterval - sinceCheckpoint.count();
+            samplesPerPass = static_cast<int>(std::min<double>(
+                    spp, std::ceil(untilCheckpoint / sampleTime)));
+            samplesPerPass = std::max(1, samplesPerPass);
+        }
+    }
+
+    std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+    Info("Rendered %d pass(es) using %d thread(s) in %.3f s",
+         progress.numPasses - firstPass, numThreads, elapsed.count());
+
+    double meanSamples, meanError;
+    _film->EstimateConvergence(&meanSamples, &meanError);
+    Info("Achieved %.2f samples per pixel, estimated error %.5f",
+         meanSamples, meanError);
+
+    if (_settings.reportFilename.empty()) {
+        return;
+    }
+
+    std::ofstream file(_settings.reportFilename);
+    if (!file) {
+        Error("Could not open render report file \"%s\"",
+              _settings.reportFilename);
+        return;
     }
+    file << "{\n";
+    file << "    \"seconds\": " << elapsed.count() << ",\n";
+    file << "    \"passes\": " << progress.numPasses << ",\n";
+    file << "    \"samples_per_pixel\": " << meanSamples << ",\n";
+    file << "    \"estimated_error\": " << meanError << "\n";
+    file << "}\n";
 }
 
 } // namespace renoster
@@ -1,11 +1,17 @@
 #include "renoster/reno.h"
 
+#include <algorithm>
 #include <iostream>
 
+#include <map>
 #include <memory>
 #include <stack>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "renoster/aggregate.h"
+#include "renoster/aov.h"
 #include "renoster/camera.h"
 #include "renoster/display.h"
 #include "renoster/film.h"
@@ -14,12 +20,14 @@
 #include "renoster/light.h"
 #include "renoster/log.h"
 #include "renoster/material.h"
+#include "renoster/parallel.h"
 #include "renoster/pixelfilter.h"
 #include "renoster/plugin.h"
 #include "renoster/primitive.h"
 #include "renoster/renderer.h"
 #include "renoster/sampler.h"
 #include "renoster/scene.h"
+#include "renoster/stats.h"
 #include "renoster/transform.h"
 
 namespace renoster {
@@ -37,6 +45,10 @@ struct Options {
     std::unique_ptr<PixelFilter> filter;
     std::unique_ptr<Integrator> integrator;
     std::unique_ptr<Sampler> sampler;
+    std::vector<Aov> aovs;
+    int numThreads = 1;
+    RenderSettings renderSettings;
+    std::string statsFilename;
 
     void Clear() {
         display.reset();
@@ -44,6 +56,7 @@ struct Options {
         filter.reset();
         integrator.reset();
         sampler.reset();
+        aovs.clear();
     }
 };
 
@@ -61,10 +74,24 @@ struct World {
     std::vector<Primitive *> geometries;
     std::vector<Primitive *> lights;
 
+    // Object definitions, and the primitives of the one being defined
+    std::map<std::string, std::shared_ptr<Primitive>> objects;
+    std::string objectName;
+    std::vector<std::shared_ptr<Primitive>> objectPrimitives;
+    bool inObject = false;
+
+    // Ids of the geometry and the instances of the scene, in the order they
+    // are declared. Hits inside an object report the id of the instance.
+    uint32_t numPrimitiveIds = 0;
+
     void Clear() {
         primitives.clear();
         geometries.clear();
         lights.clear();
+        objects.clear();
+        objectPrimitives.clear();
+        inObject = false;
+        numPrimitiveIds = 0;
     }
 };
 
@@ -76,6 +103,17 @@ static std::stack<Attributes> attributesStack;
 static Attributes curAttributes;
 static World world;
 
+// Options given on the command line, they are applied after the options of
+// the scene file
+static std::vector<std::pair<std::string, ParameterList>> optionOverrides;
+
+static void SetOption(const std::string & name, ParameterList & params);
+
+static int DefaultNumThreads()
+{
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
 void RenoBegin()
 {
     if (state != RenoState::kUninitialized) {
@@ -84,7 +122,8 @@ void RenoBegin()
     }
 
     // TODO: Create defaults for options
-    
+    options.numThreads = DefaultNumThreads();
+
     curTransform = Identity();
 
     state = RenoState::kOptions;
@@ -98,7 +137,9 @@ void RenoEnd()
     }
 
     options.Clear();
-    
+    optionOverrides.clear();
+    ParallelCleanup();
+
     state = RenoState::kUninitialized;
 }
 
@@ -109,6 +150,13 @@ void RenoWorldBegin()
         return;
     }
 
+    for (auto & option : optionOverrides) {
+        SetOption(option.first, option.second);
+    }
+
+    // Geometry may already use the task system while the world is built
+    ParallelInit(options.numThreads);
+
     curTransform = Identity();
     state = RenoState::kWorld;
 }
@@ -120,17 +168,30 @@ void RenoWorldEnd()
         return;
     }
 
+    if (world.inObject) {
+        Error("RenoWorldEnd(): object \"%s\" is not ended", world.objectName);
+        RenoObjectEnd();
+    }
+
     // Prepare for rendering
-    options.film->RenderBegin(options.filter.get(), options.display.get());
+    options.film->RenderBegin(options.filter.get(), options.display.get(),
+                              options.aovs);
     CameraEnvironment camEnv{options.film->GetScreenWindow()};
     options.camera->RenderBegin(camEnv);
 
     // Render the current scene
     Renderer renderer(options.camera.get(), options.film.get(),
-                      options.integrator.get(), options.sampler.get());
+                      options.integrator.get(), options.sampler.get(),
+                      options.renderSettings);
     Scene scene(world.geometries, world.lights);
     renderer.Render(scene);
 
+#ifdef RENOSTER_ENABLE_STATS
+    // The statistics include the BVH builds of the world
+    ReportStats(options.statsFilename);
+    ResetStats();
+#endif
+
     // Finish rendering
     options.camera->RenderEnd();
     options.film->RenderEnd();
@@ -170,11 +231,138 @@ void RenoAttributeEnd()
 
 void RenoObjectBegin(const std::string & handle)
 {
-    Error("RenoObjectBegin() is not implemented");
+    if (state != RenoState::kWorld) {
+        Error("RenoObjectBegin()");
+        return;
+    }
+
+    if (world.inObject) {
+        Error("RenoObjectBegin(): object \"%s\" cannot be defined inside "
+              "object \"%s\"", handle, world.objectName);
+        return;
+    }
+
+    RenoAttributeBegin();
+    world.objectName = handle;
+    world.inObject = true;
 }
 
-void RenoObjectEnd() {
-    Error("RenoObjectEnd() is not implemented");
+void RenoObjectEnd()
+{
+    if (state != RenoState::kWorld || !world.inObject) {
+        Error("RenoObjectEnd()");
+        return;
+    }
+
+    if (world.objectPrimitives.empty()) {
+        Warning("RenoObjectEnd(): object \"%s\" is empty", world.objectName);
+    } else {
+        if (world.objects.count(world.objectName)) {
+            Warning("RenoObjectEnd(): redefining object \"%s\"",
+                    world.objectName);
+        }
+        world.objects[world.objectName] = std::make_shared<Aggregate>(
+                std::move(world.objectPrimitives));
+    }
+
+    world.objectPrimitives.clear();
+    world.inObject = false;
+    RenoAttributeEnd();
+}
+
+void RenoObjectInstance(const std::string & handle)
+{
+    if (state != RenoState::kWorld) {
+        Error("RenoObjectInstance()");
+        return;
+    }
+
+    if (world.inObject) {
+        Error("RenoObjectInstance(): object \"%s\" cannot be instanced "
+              "inside object \"%s\"", handle, world.objectName);
+        return;
+    }
+
+    auto it = world.objects.find(handle);
+    if (it == world.objects.end()) {
+        Error("RenoObjectInstance(): unknown object \"%s\"", handle);
+        return;
+    }
+
+    // The instance is a single primitive of the scene BVH, rays are
+    // transformed into object space to traverse the BVH of the object
+    Transform WorldToInstance = Inverse(curTransform);
+    Transform InstanceToWorld = curTransform;
+    auto instance = std::make_unique<TransformedPrimitive>(
+            it->second, WorldToInstance, InstanceToWorld);
+    instance->SetPrimitiveId(++world.numPrimitiveIds);
+    world.geometries.push_back(instance.get());
+    world.primitives.push_back(std::move(instance));
+}
+
+void RenoOption(const std::string & name, ParameterList & params)
+{
+    if (state != RenoState::kOptions) {
+        Error("RenoOption()");
+        return;
+    }
+
+    SetOption(name, params);
+}
+
+void RenoOptionOverride(const std::string & name, ParameterList & params)
+{
+    if (state != RenoState::kOptions) {
+        Error("RenoOptionOverride()");
+        return;
+    }
+
+    optionOverrides.emplace_back(name, params);
+}
+
+static void SetOption(const std::string & name, ParameterList & params)
+{
+    if (name == "render") {
+        // A thread count of zero (or less) selects all hardware threads
+        int defNumThreads = options.numThreads;
+        int numThreads = params.GetInt("nthreads", &defNumThreads);
+        options.numThreads = numThreads > 0 ? numThreads : DefaultNumThreads();
+
+        // Progressive rendering takes this many samples per pixel in every
+        // pass, zero renders all samples at once
+        RenderSettings & settings = options.renderSettings;
+        int defSamplesPerPass = settings.samplesPerPass;
+        settings.samplesPerPass = std::max(
+                0, params.GetInt("passsamples", &defSamplesPerPass));
+
+        // The time limit in seconds stops rendering after the pass that
+        // would overrun it, the report tells the achieved quality
+        float defTimeLimit = settings.timeLimit;
+        settings.timeLimit = std::max(
+                0.f, params.GetFloat("timelimit", &defTimeLimit));
+        std::string defReport = settings.reportFilename;
+        settings.reportFilename = params.GetString("report", &defReport);
+
+        // Checkpoints are written between passes and when the render
+        // stops, and read back when resuming
+        std::string defCheckpoint = settings.checkpointFilename;
+        settings.checkpointFilename = params.GetString("checkpoint",
+                                                       &defCheckpoint);
+        float defInterval = settings.checkpointInterval;
+        settings.checkpointInterval = params.GetFloat("checkpointinterval",
+                                                      &defInterval);
+        bool defResume = settings.resume;
+        settings.resume = params.GetBool("resume", &defResume);
+    } else if (name == "statistics") {
+        // The statistics are written as JSON to the file, if one is given
+        std::string defFilename = options.statsFilename;
+        options.statsFilename = params.GetString("filename", &defFilename);
+#ifndef RENOSTER_ENABLE_STATS
+        Warning("RenoOption(): statistics are not enabled in this build");
+#endif
+    } else {
+        Warning("RenoOption(): unknown option \"%s\"", name);
+    }
 }
 
 void RenoTransformBegin() {
@@ -259,7 +447,19 @@ void RenoDisplay(const std::string & name, ParameterList & params)
         return;
     }
 
+    // The display receives the channels of the AOVs, in order
+    std::vector<Aov> aovs;
+    for (const std::string & aovName : params.GetStrings("aovs")) {
+        Aov aov;
+        if (!FindAov(aovName, &aov)) {
+            Error("RenoDisplay(): unknown aov \"%s\"", aovName);
+            return;
+        }
+        aovs.push_back(aov);
+    }
+
     options.display = CreateDisplay(name, params);
+    options.aovs = std::move(aovs);
 }
 
 void RenoFilm(ParameterList & params)
@@ -293,8 +493,21 @@ void RenoGeometry(const std::string & name, ParameterList & params)
     //
     Transform WorldToObject = Inverse(curTransform);
     Transform ObjectToWorld = curTransform;
+    if (world.inObject) {
+        if (light) {
+            Warning("RenoGeometry(): geometry lights are not supported in "
+                    "object \"%s\"", world.objectName);
+            light.reset();
+        }
+        auto primitive = std::make_shared<GeometricPrimitive>(
+                geometry, light, curAttributes.material, WorldToObject,
+                ObjectToWorld);
+        world.objectPrimitives.push_back(std::move(primitive));
+        return;
+    }
     auto primitive = std::make_unique<GeometricPrimitive>(
             geometry, light, curAttributes.material, WorldToObject, ObjectToWorld);
+    primitive->SetPrimitiveId(++world.numPrimitiveIds);
     world.geometries.push_back(primitive.get());
     if (light) {
         primitive->SetLightId(world.lights.size());
@@ -1,11 +1,19 @@
 #include "renoster/sampling.h"
 
 #include <algorithm>
+#include <utility>
+
+#include "renoster/rng.h"
 
 namespace renoster {
 
 Distribution1D::Distribution1D(std::vector<float> func)
 {
+    if (func.size() >= MinAliasTableSize) {
+        BuildAliasTable(func);
+        return;
+    }
+
     _cdf.resize(func.size() + 1);
     _cdf[0] = 0.f;
     for (size_t i = 0; i < func.size(); ++i) {
@@ -24,9 +32,105 @@ Distribution1D::Distribution1D(std::vector<float> func)
     }
 }
 
+void Distribution1D::BuildAliasTable(const std::vector<float> & func)
+{
+    // Sum in double precision, the tables can be large
+    double sum = 0.0;
+    for (float f : func) {
+        sum += f;
+    }
+    _funcInt = static_cast<float>(sum);
+
+    size_t n = func.size();
+    std::vector<double> scaled(n);
+    _aliasTable.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        double p = sum != 0.0 ? func[i] / sum : 1.0 / n;
+        scaled[i] = p * n;
+        _aliasTable[i].pdf = static_cast<float>(p);
+        _aliasTable[i].alias = static_cast<int>(i);
+    }
+
+    // Fill the bins below the average with the ones above it
+    std::vector<int> under, over;
+    for (size_t i = 0; i < n; ++i) {
+        (scaled[i] < 1.0 ? under : over).push_back(static_cast<int>(i));
+    }
+    while (!under.empty() && !over.empty()) {
+        int small = under.back();
+        under.pop_back();
+        int large = over.back();
+
+        _aliasTable[small].q = static_cast<float>(scaled[small]);
+        _aliasTable[small].alias = large;
+
+        scaled[large] -= 1.0 - scaled[small];
+        if (scaled[large] < 1.0) {
+            over.pop_back();
+            under.push_back(large);
+        }
+    }
+
+    // The remaining bins are full, up to rounding errors
+    for (int i : under) {
+        _aliasTable[i].q = 1.f;
+    }
+    for (int i : over) {
+        _aliasTable[i].q = 1.f;
+    }
+}
+
+int Distribution1D::SampleAliasTable(int bin, float up, float * pdf,
+                                     float * uRemapped) const
+{
+    // Keep the bin with probability q, pick its alias otherwise
+    const AliasBin & b = _aliasTable[bin];
+    int index = bin;
+    if (up < b.q) {
+        if (uRemapped) {
+            *uRemapped = std::min(up / b.q, OneMinusEpsilon);
+        }
+    } else {
+        index = b.alias;
+        if (uRemapped) {
+            *uRemapped = std::min((up - b.q) / (1.f - b.q), OneMinusEpsilon);
+        }
+    }
+
+    if (pdf) {
+        *pdf = _aliasTable[index].pdf;
+    }
+
+    return index;
+}
+
+int Distribution1D::SampleDiscrete(const Point2f & u, float * pdf,
+                                   float * uRemapped) const
+{
+    assert(u[0] >= 0.f && u[0] < 1.f);
+    assert(u[1] >= 0.f && u[1] < 1.f);
+    if (_aliasTable.empty()) {
+        return SampleDiscrete(u[0], pdf, uRemapped);
+    }
+
+    int n = static_cast<int>(_aliasTable.size());
+    int bin = std::min(static_cast<int>(u[0] * n), n - 1);
+    return SampleAliasTable(bin, u[1], pdf, uRemapped);
+}
+
 int Distribution1D::SampleDiscrete(float u, float * pdf, float * uRemapped) const
 {
     assert(u >= 0.f && u < 1.f);
+    if (!_aliasTable.empty()) {
+        // The integer part of u * n picks the bin, its fraction decides
+        // between the bin and its alias
+        int n = static_cast<int>(_aliasTable.size());
+        float un = u * n;
+        int bin = std::min(static_cast<int>(un), n - 1);
+        float up = std::min(un - bin, OneMinusEpsilon);
+        return SampleAliasTable(bin, up, pdf, uRemapped);
+    }
+
     auto it = std::upper_bound(_cdf.begin(), _cdf.end(), u);
     size_t index = std::distance(_cdf.begin(), it) - 1;
     assert(index < _cdf.size() - 1);
@@ -45,6 +149,9 @@ int Distribution1D::SampleDiscrete(float u, float * pdf, float * uRemapped) cons
 
 float Distribution1D::PdfDiscrete(int index) const
 {
+    if (!_aliasTable.empty()) {
+        return _aliasTable[index].pdf;
+    }
     return _cdf[index + 1] - _cdf[index];
 }
 
@@ -2,6 +2,7 @@
 
 #include "renoster/accel/builder.h"
 #include "renoster/accel/splitter.h"
+#include "renoster/stats.h"
 
 namespace renoster {
 
@@ -13,12 +14,14 @@ Scene::Scene(std::vector<Primitive *> geometries,
     _bvh = std::make_unique<BVH>();
     ObjectSplitter splitter;
     size_t minLeafSize = 1;
-    BVHBuilder<Primitive, ObjectSplitter> builder(_bvh.get(), splitter,
-                                                  minLeafSize);
+    BVHBuilder<Primitive, ObjectSplitter> builder(
+            _bvh.get(), splitter, minLeafSize, BVH::NativeWidth());
     PrimitiveContext pCtx;
     builder.Build(pCtx, geometries);
 
-    // Build a distribution over the instanced lights in the scene
+    // Build a light BVH over the instanced lights in the scene, and a
+    // distribution for emitting from them
+    _lightBvh = LightBVH(_lights);
     if (!_lights.empty()) {
         std::vector<float> prob(_lights.size(), 1.f);
         _lightDistrib = Distribution1D(std::move(prob));
@@ -27,12 +30,14 @@ Scene::Scene(std::vector<Primitive *> geometries,
 
 bool Scene::Intersect(const Ray3f & ray, ShadingPoint * sp) const
 {
+    RENO_STAT_ADD(Stat::kIntersectRays, 1);
     PrimitiveContext ctx;
     return _bvh->Intersect<Primitive, PrimitiveContext>(ctx, ray, sp);
 }
 
 bool Scene::Occluded(const Ray3f & ray) const
 {
+    RENO_STAT_ADD(Stat::kOccludedRays, 1);
     PrimitiveContext ctx;
     return _bvh->Occluded<Primitive, PrimitiveContext>(ctx, ray);
 }
@@ -45,10 +50,13 @@ Color Scene::SampleDirect(Sampler & sampler, const ShadingPoint & ref,
         return Color(0.f);
     }
 
-    // Select a light
+    // Select a light with respect to the shading point
     float lightPdf;
-    float u = sampler.Get1D();
-    size_t index = _lightDistrib.SampleDiscrete(u, &lightPdf, &u);
+    int index = _lightBvh.Sample(ref, sampler.Get1D(), &lightPdf);
+    if (index == -1) {
+        *pdf = 0.f;
+        return Color(0.f);
+    }
 
     // Sample a point on the light
     float directPdf;
@@ -73,7 +81,7 @@ Color Scene::EvaluateDirect(const ShadingPoint & ref, const ShadingPoint & pos,
         *pdf = 0.f;
         return Color(0.f);
     }
-    float lightPdf = _lightDistrib.PdfDiscrete(lightId);
+    float lightPdf = _lightBvh.Pmf(ref, static_cast<int>(lightId));
 
     // Evaluate the light at the shading point
     float directPdf;
@@ -94,8 +102,8 @@ Color Scene::SampleEmission(Sampler & sampler, ShadingPoint * pos,
 
     // Select a light
     float lightPdf;
-    float u = sampler.Get1D();
-    size_t index = _lightDistrib.SampleDiscrete(u, &lightPdf, &u);
+    size_t index = _lightDistrib.SampleDiscrete(sampler.Get2D(), &lightPdf,
+                                                nullptr);
 
     // Sample a point on the light
     float directPdf;
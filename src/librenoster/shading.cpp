@@ -7,13 +7,21 @@ namespace renoster {
 void ShadingPoint::ComputeShadingInfo()
 {
     PrimitiveContext ctx;
-    primitive->ComputeShadingInfo(ctx, this);
+    if (instance) {
+        instance->ComputeShadingInfo(ctx, this);
+    } else {
+        primitive->ComputeShadingInfo(ctx, this);
+    }
 }
 
 void ShadingPoint::ComputeScatteringFunctions(Allocator & alloc)
 {
     PrimitiveContext ctx;
-    primitive->ComputeScatteringFunctions(ctx, alloc, this);
+    if (instance) {
+        instance->ComputeScatteringFunctions(ctx, alloc, this);
+    } else {
+        primitive->ComputeScatteringFunctions(ctx, alloc, this);
+    }
 }
 
 }  // namespace renoster
@@ -0,0 +1,173 @@
+#include "renoster/stats.h"
+
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+#include "renoster/log.h"
+
+namespace renoster {
+
+namespace {
+
+enum class StatKind {
+    kCounter,
+    kMaximum
+};
+
+struct StatInfo {
+    Stat stat;
+    StatKind kind;
+    const char * name;
+    const char * key;
+};
+
+const StatInfo statInfos[] = {
+    {Stat::kCameraRays, StatKind::kCounter, "Camera rays", "camera_rays"},
+    {Stat::kIntersectRays, StatKind::kCounter, "Intersect rays",
+     "intersect_rays"},
+    {Stat::kOccludedRays, StatKind::kCounter, "Occluded (shadow) rays",
+     "occluded_rays"},
+    {Stat::kNodeVisits, StatKind::kCounter, "BVH node visits",
+     "node_visits"},
+    {Stat::kLeafVisits, StatKind::kCounter, "BVH leaf visits",
+     "leaf_visits"},
+    {Stat::kPrimitiveTests, StatKind::kCounter, "Primitive tests",
+     "primitive_tests"},
+    {Stat::kLeaves, StatKind::kCounter, "BVH leaves built", "leaves"},
+    {Stat::kLeafPrimitives, StatKind::kCounter, "Primitives in leaves",
+     "leaf_primitives"},
+    {Stat::kRussianRouletteKills, StatKind::kCounter,
+     "Paths terminated by Russian roulette", "russian_roulette_kills"},
+    {Stat::kMaxLeafSize, StatKind::kMaximum, "Largest leaf",
+     "max_leaf_size"},
+    {Stat::kAllocatorPeakBytes, StatKind::kMaximum,
+     "Peak allocator bytes per thread", "allocator_peak_bytes"}
+};
+
+static_assert(sizeof(statInfos) / sizeof(statInfos[0]) ==
+              static_cast<size_t>(Stat::kNumStats),
+              "every Stat needs a StatInfo");
+
+constexpr size_t NumStats = static_cast<size_t>(Stat::kNumStats);
+
+void Merge(uint64_t * total, const uint64_t * values)
+{
+    for (const StatInfo & info : statInfos) {
+        size_t i = static_cast<size_t>(info.stat);
+        if (info.kind == StatKind::kCounter) {
+            total[i] += values[i];
+        } else {
+            total[i] = std::max(total[i], values[i]);
+        }
+    }
+}
+
+/// Registry keeps track of the statistics of the running threads and holds
+/// the merged statistics of the threads that have exited
+class Registry {
+public:
+    void Register(ThreadStats * stats) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _threads.push_back(stats);
+    }
+
+    void Unregister(ThreadStats * stats) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Merge(_exited, stats->values);
+        _threads.erase(std::find(_threads.begin(), _threads.end(), stats));
+    }
+
+    void Collect(uint64_t * total) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::copy(_exited, _exited + NumStats, total);
+        for (ThreadStats * stats : _threads) {
+            Merge(total, stats->values);
+        }
+    }
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::fill(_exited, _exited + NumStats, 0);
+        for (ThreadStats * stats : _threads) {
+            std::fill(stats->values, stats->values + NumStats, 0);
+        }
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<ThreadStats *> _threads;
+    uint64_t _exited[NumStats] = {};
+};
+
+/// The registry is created by the first ThreadStats, so it outlives them
+Registry & GetRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+}  // anonymous namespace
+
+ThreadStats::ThreadStats()
+{
+    GetRegistry().Register(this);
+}
+
+ThreadStats::~ThreadStats()
+{
+    GetRegistry().Unregister(this);
+}
+
+ThreadStats & GetThreadStats()
+{
+    thread_local ThreadStats stats;
+    return stats;
+}
+
+void ReportStats(const std::string & jsonFilename)
+{
+    uint64_t total[NumStats];
+    GetRegistry().Collect(total);
+    auto value = [&](Stat stat) { return total[static_cast<size_t>(stat)]; };
+
+    // Derived statistics
+    uint64_t numRays = value(Stat::kIntersectRays) +
+                       value(Stat::kOccludedRays);
+    double nodesPerRay = numRays == 0 ? 0.0 :
+            static_cast<double>(value(Stat::kNodeVisits)) / numRays;
+    double meanLeafSize = value(Stat::kLeaves) == 0 ? 0.0 :
+            static_cast<double>(value(Stat::kLeafPrimitives)) /
+            value(Stat::kLeaves);
+
+    Info("Statistics:");
+    for (const StatInfo & info : statInfos) {
+        Info("    %-40s %16d", info.name, value(info.stat));
+    }
+    Info("    %-40s %16.2f", "BVH node visits per ray", nodesPerRay);
+    Info("    %-40s %16.2f", "Mean leaf size", meanLeafSize);
+
+    if (jsonFilename.empty()) {
+        return;
+    }
+
+    std::ofstream file(jsonFilename);
+    if (!file) {
+        Error("Could not open statistics file \"%s\"", jsonFilename);
+        return;
+    }
+    file << "{\n";
+    for (const StatInfo & info : statInfos) {
+        file << "    \"" << info.key << "\": " << value(info.stat) << ",\n";
+    }
+    file << "    \"node_visits_per_ray\": " << nodesPerRay << ",\n";
+    file << "    \"mean_leaf_size\": " << meanLeafSize << "\n";
+    file << "}\n";
+}
+
+void ResetStats()
+{
+    GetRegistry().Reset();
+}
+
+}  // namespace renoster
@@ -23,6 +23,11 @@ Transform Identity() {
     return Transform(Matrix4x4f(mat), Matrix4x4f(matInv));
 }
 
+const Transform & IdentityTransform() {
+    static const Transform identity = Identity();
+    return identity;
+}
+
 Transform Translate(float dx, float dy, float dz) {
     float mat[4][4] = {
         {1.f, 0.f, 0.f, dx},
@@ -110,14 +115,14 @@ Transform Rotate(float angle, const Vector3f & axis) {
     Matrix4x4f mat;
     mat(0, 0) = a.x() * a.x() + (1.f - a.x() * a.x()) * cosA;
     mat(0, 1) = a.x() * a.y() * (1.f - cosA) - a.z() * sinA;
-    mat(0, 2) = a.x() * a.z() * (1.f - cosA) - a.y() + sinA;
+    mat(0, 2) = a.x() * a.z() * (1.f - cosA) + a.y() * sinA;
     mat(0, 3) = 0.f;
     mat(1, 0) = a.x() * a.y() * (1.f - cosA) + a.z() * sinA;
     mat(1, 1) = a.y() * a.y() + (1.f - a.y() * a.y()) * cosA;
     mat(1, 2) = a.y() * a.z() * (1.f - cosA) - a.x() * sinA;
     mat(1, 3) = 0.f;
     mat(2, 0) = a.x() * a.z() * (1.f - cosA) - a.y() * sinA;
-    mat(2, 1) = a.y() * a.z() * (1.f - cosA) + a.z() * sinA;
+    mat(2, 1) = a.y() * a.z() * (1.f - cosA) + a.x() * sinA;
     mat(2, 2) = a.z() * a.z() + (1.f - a.z() * a.z()) * cosA;
     mat(2, 3) = 0.f;
     mat(3, 0) = 0.f;
@@ -4,6 +4,7 @@
 
 #include <boost/program_options.hpp>
 
+#include "renoster/paramlist.h"
 #include "renoster/plugin.h"
 #include "renoster/reno.h"
 #include "renoster/renoparser.h"
@@ -13,7 +14,8 @@ namespace po = boost::program_options;
 using namespace renoster;
 
 int main(int argc, char * argv[]) {
-    int nthreads = 1;
+    int nthreads = 0;
+    bool resume = false;
     std::vector<std::string> filenames;
 
     po::options_description generic("Generic options");
@@ -21,9 +23,13 @@ int main(int argc, char * argv[]) {
         ("version,v", "print version string")
         ("help,h", "produce help message");
 
+    // These override the options of the scene file
     po::options_description rendering("Rendering options");
     rendering.add_options()
-        ("nthreads", po::value<int>(&nthreads), "set number of threads used");
+        ("nthreads", po::value<int>(&nthreads),
+         "set number of threads used (0 uses all hardware threads)")
+        ("resume", po::bool_switch(&resume),
+         "continue the render from its checkpoint, if there is one");
 
     po::options_description hidden("Hidden options");
     hidden.add_options()
@@ -67,6 +73,14 @@ int main(int argc, char * argv[]) {
     {
         SetPluginSearchPath(".");
         RenoBegin();
+        ParameterList params;
+        if (nthreads > 0) {
+            params.SetInts("nthreads", {nthreads});
+        }
+        if (resume) {
+            params.SetBools("resume", {true});
+        }
+        RenoOptionOverride("render", params);
         ParseRenoFile(filename);
         RenoEnd();
     }
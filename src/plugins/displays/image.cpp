@@ -1,5 +1,8 @@
 #include "renoster/display.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "OpenImageIO/imageio.h"
 
 namespace renoster {
@@ -9,10 +12,16 @@ public:
     ImageDisplay(const std::string & filename)
         : filename_(filename) {}
 
-    bool Open(const Vector2i & resolution);
+    bool Open(const Vector2i & resolution,
+              const std::vector<std::string> & channelNames);
 
     bool WriteData(float * pixels);
 
+    bool OpenTiles(const Vector2i & resolution, const Vector2i & tileSize,
+                   const std::vector<std::string> & channelNames);
+
+    bool WriteTile(const Bounds2i & bounds, float * pixels);
+
     bool Close();
 
     std::string GetError();
@@ -20,15 +29,20 @@ public:
 private:
     std::string filename_;
     std::unique_ptr<OIIO::ImageOutput> out_;
+    Vector2i tileSize_;
+    int nChannels_;
+    std::vector<float> tileData_;
 };
 
-bool ImageDisplay::Open(const Vector2i & resolution) {
+bool ImageDisplay::Open(const Vector2i & resolution,
+                        const std::vector<std::string> & channelNames) {
     out_.reset(OIIO::ImageOutput::create(filename_));
     if (!out_) {
         return false;
     }
-    OIIO::ImageSpec spec(resolution.x(), resolution.y(), 3,
+    OIIO::ImageSpec spec(resolution.x(), resolution.y(), channelNames.size(),
                          OIIO::TypeDesc::FLOAT);
+    spec.channelnames = channelNames;
     return out_->open(filename_, spec);
 }
 
@@ -39,6 +53,47 @@ bool ImageDisplay::WriteData(float * pixels) {
     return out_->write_image(OIIO::TypeDesc::FLOAT, pixels);
 }
 
+bool ImageDisplay::OpenTiles(const Vector2i & resolution,
+                             const Vector2i & tileSize,
+                             const std::vector<std::string> & channelNames) {
+    out_.reset(OIIO::ImageOutput::create(filename_));
+    if (!out_ || !out_->supports("tiles")) {
+        out_.reset();
+        return false;
+    }
+    OIIO::ImageSpec spec(resolution.x(), resolution.y(), channelNames.size(),
+                         OIIO::TypeDesc::FLOAT);
+    spec.channelnames = channelNames;
+    spec.tile_width = tileSize.x();
+    spec.tile_height = tileSize.y();
+    // Tiles arrive in the order they finish
+    spec.attribute("openexr:lineOrder", "randomY");
+    tileSize_ = tileSize;
+    nChannels_ = channelNames.size();
+    tileData_.assign(nChannels_ * tileSize.x() * tileSize.y(), 0.f);
+    return out_->open(filename_, spec);
+}
+
+bool ImageDisplay::WriteTile(const Bounds2i & bounds, float * pixels) {
+    if (!out_) {
+        return false;
+    }
+
+    // Tiles are always passed in full, pad the ones at the edges
+    Vector2i extent = bounds.Diagonal();
+    float * data = pixels;
+    if (extent.x() != tileSize_.x() || extent.y() != tileSize_.y()) {
+        for (int y = 0; y < extent.y(); ++y) {
+            std::copy(pixels + nChannels_ * y * extent.x(),
+                      pixels + nChannels_ * (y + 1) * extent.x(),
+                      tileData_.begin() + nChannels_ * y * tileSize_.x());
+        }
+        data = tileData_.data();
+    }
+    return out_->write_tile(bounds.min().x(), bounds.min().y(), 0,
+                            OIIO::TypeDesc::FLOAT, data);
+}
+
 bool ImageDisplay::Close() {
     if (out_) {
         return out_->close();
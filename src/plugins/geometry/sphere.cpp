@@ -22,6 +22,8 @@ public:
 
     float Pdf(const GeometryContext & ctx, const ShadingPoint & sp) const;
 
+    float Area(const GeometryContext & ctx) const;
+
     Bounds3f GetObjectBounds() const;
 
 private:
@@ -179,7 +181,7 @@ void Sphere::ComputeShadingInfo(const GeometryContext & ctx,
 {
     // Transform to object space
     Point3f pHit = ctx.WorldToObject(sp->p);
-    Normal3f n = ctx.WorldToObject(sp->ng);
+    Normal3f n = Normalize(ctx.WorldToObject(sp->ng));
 
     // Recover spherical coordinates
     float phi = sp->u * _phiMax;
@@ -254,6 +256,17 @@ float Sphere::Pdf(const GeometryContext & ctx, const ShadingPoint & sp) const
     return 1.f / (_phiMax * _radius * (_zMax - _zMin));
 }
 
+float Sphere::Area(const GeometryContext & ctx) const
+{
+    // Scale by the average squared length of the transformed axes, which
+    // is exact for uniform scales
+    float scale2 = (LengthSquared(ctx.ObjectToWorld(Vector3f(1.f, 0.f, 0.f))) +
+                    LengthSquared(ctx.ObjectToWorld(Vector3f(0.f, 1.f, 0.f))) +
+                    LengthSquared(ctx.ObjectToWorld(Vector3f(0.f, 0.f, 1.f)))) /
+                   3.f;
+    return _phiMax * _radius * (_zMax - _zMin) * scale2;
+}
+
 Bounds3f Sphere::GetObjectBounds() const
 {
     return Bounds3f(Point3f(-_radius, -_radius, _zMin),
@@ -2,10 +2,14 @@
 #include "renoster/accel/splitter.h"
 #include "renoster/bvh.h"
 #include "renoster/geometry.h"
+#include "renoster/log.h"
 #include "renoster/sampling.h"
+#include "renoster/stats.h"
 
 #include <cassert>
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace renoster {
@@ -31,19 +35,102 @@ public:
 
     float Pdf(const GeometryContext & ctx, const ShadingPoint & sp) const;
 
+    float Area(const GeometryContext & ctx) const;
+
+    DirectionCone GetNormalCone(const GeometryContext & ctx) const;
+
     Bounds3f GetObjectBounds() const;
 
     Bounds3f GetWorldBounds(const GeometryContext & ctx) const;
 
+    void SplitBounds(const GeometryContext & ctx, const Bounds3f & bounds,
+                     size_t dim, float pos, Bounds3f * left,
+                     Bounds3f * right) const;
+
+    /// Fills in sp for a hit with barycentric coordinates b0, b1 and b2
+    void SetIntersection(const GeometryContext & ctx, const Ray3f & ray,
+                         float b0, float b1, float b2,
+                         ShadingPoint * sp) const;
+
+    size_t GetFace() const { return _face; }
+
+    /// Returns the vertex positions in object space
+    void GetPositions(Point3f * p0, Point3f * p1, Point3f * p2) const;
+
 private:
     size_t _face;
     const TriangleMesh * _mesh;
 };
 
+/// TriangleRay holds the ray setup of the watertight ray triangle test,
+/// which is shared by all triangles, and the closest hit so far
+struct TriangleRay {
+    explicit TriangleRay(const Ray3f & ray);
+
+    Point3f org;
+
+    // Permutation that makes z the dimension with the largest direction
+    int kx, ky, kz;
+
+    // Shear that transforms the direction to the unit z direction
+    float Sx, Sy, Sz;
+
+    // Closest hit
+    mutable size_t face;
+    mutable float b0, b1, b2;
+};
+
+/// Triangle4 stores four triangles in SoA form, so they can be tested
+/// against a ray at once. Unused slots repeat the last triangle.
+struct Triangle4 {
+    Triangle4() = default;
+
+    Triangle4(Triangle * const * triangles, size_t numTriangles);
+
+    /// Returns the mask of triangles hit within the ray interval and their
+    /// scaled barycentric coordinates and distances.
+    vbool4 Intersect(const TriangleRay & triRay, const Ray3f & ray,
+                     vfloat4 * e0, vfloat4 * e1, vfloat4 * e2,
+                     vfloat4 * det, vfloat4 * tScaled) const;
+
+    Point3vf4 p0;
+    Point3vf4 p1;
+    Point3vf4 p2;
+    size_t faces[4];
+};
+
+/// Leaves of the triangle mesh BVH store their triangles in Triangle4
+/// packs right after the node, so a leaf test reads no mesh data
+template <>
+struct alignas(16) BVH::LeafNode<Triangle4> {
+    static constexpr uint16_t Type = kLeaf;
+
+    static size_t GetNumPacks(size_t numPrimitives) {
+        return (numPrimitives + 3) / 4;
+    }
+
+    static size_t GetSize(size_t numPrimitives) {
+        return sizeof(LeafNode) +
+               GetNumPacks(numPrimitives) * sizeof(Triangle4);
+    }
+
+    static LeafNode * Create(void * bytes, Triangle * const * triangles,
+                             size_t numPrimitives);
+
+    bool Intersect(const TriangleRay & triRay, const Ray3f & ray,
+                   ShadingPoint * sp) const;
+
+    bool Occluded(const TriangleRay & triRay, const Ray3f & ray) const;
+
+    size_t numPrimitives;
+    Triangle4 * packs;
+};
+
 class TriangleMesh : public Geometry {
 public:
     TriangleMesh(std::vector<int> vertices, std::vector<Point3f> p,
-                 std::vector<Normal3f> n, std::vector<Point2f> uv);
+                 std::vector<Normal3f> n, std::vector<Point2f> uv,
+                 const std::string & splitter, bool quantize);
 
     bool Intersect(const GeometryContext & ctx, const Ray3f & ray,
                    ShadingPoint * sp) const;
@@ -58,6 +145,10 @@ public:
 
     float Pdf(const GeometryContext & ctx, const ShadingPoint & sp) const;
 
+    float Area(const GeometryContext & ctx) const;
+
+    DirectionCone GetNormalCone(const GeometryContext & ctx) const;
+
     Bounds3f GetObjectBounds() const;
 
     Bounds3f GetWorldBounds(const GeometryContext & ctx) const;
@@ -132,7 +223,7 @@ bool Triangle::Intersect(const GeometryContext & ctx, const Ray3f & ray,
     if (e0 == 0 || e1 == 0 || e2 == 0) {
         double p1txp2ty = double(p1t.x()) * double(p2t.y());
         double p1typ2tx = double(p1t.y()) * double(p2t.x());
-        e0 = float(p1txp2ty - p1txp2ty);
+        e0 = float(p1txp2ty - p1typ2tx);
 
         double p2txp0ty = double(p2t.x()) * double(p0t.y());
         double p2typ0tx = double(p2t.y()) * double(p0t.x());
@@ -173,25 +264,7 @@ bool Triangle::Intersect(const GeometryContext & ctx, const Ray3f & ray,
     
     ray.tMax() = tScaled * invDet;
 
-    sp->p = ctx.ObjectToWorld(b0 * p0 + b1 * p1 + b2 * p2);
-    sp->face = _face;
-    sp->wo = -ray.d();
-
-    Point2f uv0, uv1, uv2;
-    if (!_mesh->_uv.empty()) {
-        uv0 = _mesh->_uv[v0];   
-        uv1 = _mesh->_uv[v0];   
-        uv2 = _mesh->_uv[v0];
-    } else {
-        uv0 = Point2f(0.f, 0.f);
-        uv1 = Point2f(1.f, 0.f);
-        uv2 = Point2f(0.f, 1.f);
-    }
-
-    sp->u = b0 * uv0[0] + b1 * uv1[0] + b2 * uv2[0];
-    sp->v = b0 * uv0[1] + b1 * uv1[1] + b2 * uv2[1];
-
-    sp->ng = Normalize(Cross(p0 - p2, p1 - p2));
+    SetIntersection(ctx, ray, b0, b1, b2, sp);
 
     return true;
 }
@@ -249,7 +322,7 @@ bool Triangle::Occluded(const GeometryContext & ctx, const Ray3f & ray) const
     if (e0 == 0 || e1 == 0 || e2 == 0) {
         double p1txp2ty = double(p1t.x()) * double(p2t.y());
         double p1typ2tx = double(p1t.y()) * double(p2t.x());
-        e0 = float(p1txp2ty - p1txp2ty);
+        e0 = float(p1txp2ty - p1typ2tx);
 
         double p2txp0ty = double(p2t.x()) * double(p0t.y());
         double p2typ0tx = double(p2t.y()) * double(p0t.x());
@@ -285,6 +358,48 @@ bool Triangle::Occluded(const GeometryContext & ctx, const Ray3f & ray) const
     return true;
 }
 
+void Triangle::SetIntersection(const GeometryContext & ctx, const Ray3f & ray,
+                               float b0, float b1, float b2,
+                               ShadingPoint * sp) const
+{
+    // Get vertex indices
+    int v0 = _mesh->_vertices[3 * _face];
+    int v1 = _mesh->_vertices[3 * _face + 1];
+    int v2 = _mesh->_vertices[3 * _face + 2];
+
+    // Get vertex positions
+    Point3f p0 = ctx.ObjectToWorld(_mesh->_p[v0]);
+    Point3f p1 = ctx.ObjectToWorld(_mesh->_p[v1]);
+    Point3f p2 = ctx.ObjectToWorld(_mesh->_p[v2]);
+
+    sp->p = b0 * p0 + b1 * p1 + b2 * p2;
+    sp->face = _face;
+    sp->wo = -ray.d();
+
+    Point2f uv0, uv1, uv2;
+    if (!_mesh->_uv.empty()) {
+        uv0 = _mesh->_uv[v0];
+        uv1 = _mesh->_uv[v1];
+        uv2 = _mesh->_uv[v2];
+    } else {
+        uv0 = Point2f(0.f, 0.f);
+        uv1 = Point2f(1.f, 0.f);
+        uv2 = Point2f(0.f, 1.f);
+    }
+
+    sp->u = b0 * uv0[0] + b1 * uv1[0] + b2 * uv2[0];
+    sp->v = b0 * uv0[1] + b1 * uv1[1] + b2 * uv2[1];
+
+    sp->ng = sp->ns = Normalize(Cross(p0 - p2, p1 - p2));
+}
+
+void Triangle::GetPositions(Point3f * p0, Point3f * p1, Point3f * p2) const
+{
+    *p0 = _mesh->_p[_mesh->_vertices[3 * _face]];
+    *p1 = _mesh->_p[_mesh->_vertices[3 * _face + 1]];
+    *p2 = _mesh->_p[_mesh->_vertices[3 * _face + 2]];
+}
+
 void Triangle::ComputeShadingInfo(const GeometryContext & ctx,
                                   ShadingPoint * sp) const
 {
@@ -406,6 +521,31 @@ float Triangle::Pdf(const GeometryContext & ctx, const ShadingPoint & sp) const
     return 1.f / (0.5f * Cross(p1 - p0, p2 - p0).Length());
 }
 
+float Triangle::Area(const GeometryContext & ctx) const
+{
+    Point3f p0, p1, p2;
+    GetPositions(&p0, &p1, &p2);
+    p0 = ctx.ObjectToWorld(p0);
+    p1 = ctx.ObjectToWorld(p1);
+    p2 = ctx.ObjectToWorld(p2);
+    return 0.5f * Cross(p1 - p0, p2 - p0).Length();
+}
+
+DirectionCone Triangle::GetNormalCone(const GeometryContext & ctx) const
+{
+    // Same orientation as the normals of the intersections and samples
+    Point3f p0, p1, p2;
+    GetPositions(&p0, &p1, &p2);
+    p0 = ctx.ObjectToWorld(p0);
+    p1 = ctx.ObjectToWorld(p1);
+    p2 = ctx.ObjectToWorld(p2);
+    Vector3f n = Cross(p1 - p0, p2 - p0);
+    if (LengthSquared(n) == 0.f) {
+        return DirectionCone();
+    }
+    return DirectionCone(n, 1.f);
+}
+
 Bounds3f Triangle::GetObjectBounds() const
 {
     // Get the vertex indices
@@ -442,8 +582,217 @@ Bounds3f Triangle::GetWorldBounds(const GeometryContext & ctx) const
     return bounds;
 }
 
+void Triangle::SplitBounds(const GeometryContext & ctx,
+                           const Bounds3f & bounds, size_t dim, float pos,
+                           Bounds3f * left, Bounds3f * right) const
+{
+    // Get the vertex indices
+    int v0 = _mesh->_vertices[3 * _face];
+    int v1 = _mesh->_vertices[3 * _face + 1];
+    int v2 = _mesh->_vertices[3 * _face + 2];
+
+    // Get the vertex positions
+    Point3f p[3] = {ctx.ObjectToWorld(_mesh->_p[v0]),
+                    ctx.ObjectToWorld(_mesh->_p[v1]),
+                    ctx.ObjectToWorld(_mesh->_p[v2])};
+
+    // Clip the edges against the plane
+    *left = Bounds3f();
+    *right = Bounds3f();
+    for (size_t i = 0; i < 3; ++i) {
+        const Point3f & p0 = p[i];
+        const Point3f & p1 = p[(i + 1) % 3];
+
+        if (p0[dim] <= pos) {
+            left->ExpandBy(p0);
+        }
+        if (p0[dim] >= pos) {
+            right->ExpandBy(p0);
+        }
+
+        if ((p0[dim] < pos && pos < p1[dim])
+            || (p1[dim] < pos && pos < p0[dim])) {
+            float t = (pos - p0[dim]) / (p1[dim] - p0[dim]);
+            Point3f pClip = Lerp(p0, p1, t);
+            pClip[dim] = pos;
+            left->ExpandBy(pClip);
+            right->ExpandBy(pClip);
+        }
+    }
+
+    // Earlier splits may already have clipped the triangle
+    *left = Intersection(*left, bounds);
+    *right = Intersection(*right, bounds);
+}
+
+TriangleRay::TriangleRay(const Ray3f & ray)
+    : org(ray.o()), face(0), b0(0.f), b1(0.f), b2(0.f)
+{
+    // Make sure the z-value of the direction has the largest absolute value
+    kz = MaxDimension(Abs(ray.d()));
+    kx = (kz == 2) ? 0 : kz + 1;
+    ky = (kx == 2) ? 0 : kx + 1;
+
+    // Preserve winding order
+    if (ray.d()[kz] < 0.f) {
+        std::swap(kx, ky);
+    }
+
+    Vector3f d = Permute(ray.d(), Vector3i(kx, ky, kz));
+    Sx = -d.x() / d.z();
+    Sy = -d.y() / d.z();
+    Sz = 1.f / d.z();
+}
+
+Triangle4::Triangle4(Triangle * const * triangles, size_t numTriangles)
+{
+    for (size_t i = 0; i < 4; ++i) {
+        const Triangle * triangle = triangles[std::min(i, numTriangles - 1)];
+        Point3f q0, q1, q2;
+        triangle->GetPositions(&q0, &q1, &q2);
+        for (size_t d = 0; d < 3; ++d) {
+            p0[d][i] = q0[d];
+            p1[d][i] = q1[d];
+            p2[d][i] = q2[d];
+        }
+        faces[i] = triangle->GetFace();
+    }
+}
+
+vbool4 Triangle4::Intersect(const TriangleRay & triRay, const Ray3f & ray,
+                            vfloat4 * e0, vfloat4 * e1, vfloat4 * e2,
+                            vfloat4 * det, vfloat4 * tScaled) const
+{
+    int kx = triRay.kx;
+    int ky = triRay.ky;
+    int kz = triRay.kz;
+
+    // Place ray origin at the origin and permute the dimensions
+    vfloat4 orgX(triRay.org[kx]);
+    vfloat4 orgY(triRay.org[ky]);
+    vfloat4 orgZ(triRay.org[kz]);
+    vfloat4 p0x = p0[kx] - orgX, p0y = p0[ky] - orgY, p0z = p0[kz] - orgZ;
+    vfloat4 p1x = p1[kx] - orgX, p1y = p1[ky] - orgY, p1z = p1[kz] - orgZ;
+    vfloat4 p2x = p2[kx] - orgX, p2y = p2[ky] - orgY, p2z = p2[kz] - orgZ;
+
+    // Transform the direction to the unit direction
+    vfloat4 Sx(triRay.Sx);
+    vfloat4 Sy(triRay.Sy);
+    p0x += Sx * p0z;
+    p0y += Sy * p0z;
+    p1x += Sx * p1z;
+    p1y += Sy * p1z;
+    p2x += Sx * p2z;
+    p2y += Sy * p2z;
+
+    // Calculate scaled barycentric coordinates
+    *e0 = p1x * p2y - p1y * p2x;
+    *e1 = p2x * p0y - p2y * p0x;
+    *e2 = p0x * p1y - p0y * p1x;
+
+    // Recompute the edge functions that are exactly zero in double precision
+    vfloat4 zero(0.f);
+    size_t zeroMask = MoveMask((*e0 == zero) | (*e1 == zero) | (*e2 == zero));
+    for (size_t i = 0; zeroMask != 0; ++i, zeroMask >>= 1) {
+        if (!(zeroMask & 1)) {
+            continue;
+        }
+        (*e0)[i] = float(double(p1x[i]) * double(p2y[i]) -
+                         double(p1y[i]) * double(p2x[i]));
+        (*e1)[i] = float(double(p2x[i]) * double(p0y[i]) -
+                         double(p2y[i]) * double(p0x[i]));
+        (*e2)[i] = float(double(p0x[i]) * double(p1y[i]) -
+                         double(p0y[i]) * double(p1x[i]));
+    }
+
+    // The ray misses triangles with edge functions of different signs
+    vbool4 mask = ((*e0 >= zero) & (*e1 >= zero) & (*e2 >= zero)) |
+                  ((*e0 <= zero) & (*e1 <= zero) & (*e2 <= zero));
+
+    *det = *e0 + *e1 + *e2;
+    mask &= *det != zero;
+    if (MoveMask(mask) == 0) {
+        return mask;
+    }
+
+    // Calculate scaled hit distance
+    vfloat4 Sz(triRay.Sz);
+    *tScaled = *e0 * (p0z * Sz) + *e1 * (p1z * Sz) + *e2 * (p2z * Sz);
+
+    // Test against the ray interval without dividing by det
+    vfloat4 tMinScaled = vfloat4(ray.tMin()) * *det;
+    vfloat4 tMaxScaled = vfloat4(ray.tMax()) * *det;
+    mask &= ((*det < zero) & (*tScaled < tMinScaled) &
+             (*tScaled >= tMaxScaled)) |
+            ((*det > zero) & (*tScaled > tMinScaled) &
+             (*tScaled <= tMaxScaled));
+
+    return mask;
+}
+
+BVH::LeafNode<Triangle4> * BVH::LeafNode<Triangle4>::Create(
+        void * bytes, Triangle * const * triangles, size_t numPrimitives)
+{
+    LeafNode * leaf = new (bytes) LeafNode;
+    leaf->numPrimitives = numPrimitives;
+    leaf->packs = reinterpret_cast<Triangle4 *>(leaf + 1);
+    for (size_t i = 0; i < GetNumPacks(numPrimitives); ++i) {
+        new (&leaf->packs[i]) Triangle4(
+                triangles + 4 * i, std::min<size_t>(4, numPrimitives - 4 * i));
+    }
+    return leaf;
+}
+
+bool BVH::LeafNode<Triangle4>::Intersect(const TriangleRay & triRay,
+                                         const Ray3f & ray,
+                                         ShadingPoint *) const
+{
+    RENO_STAT_ADD(Stat::kPrimitiveTests, numPrimitives);
+    bool hit = false;
+    for (size_t p = 0; p < GetNumPacks(numPrimitives); ++p) {
+        vfloat4 e0, e1, e2, det, tScaled;
+        size_t mask = MoveMask(packs[p].Intersect(triRay, ray, &e0, &e1, &e2,
+                                                  &det, &tScaled));
+
+        // Keep the closest hit, lanes are tested in order
+        for (size_t i = 0; mask != 0; ++i, mask >>= 1) {
+            if (!(mask & 1)) {
+                continue;
+            }
+            float invDet = 1.f / det[i];
+            float t = tScaled[i] * invDet;
+            if (hit && t >= ray.tMax()) {
+                continue;
+            }
+            ray.tMax() = t;
+            triRay.face = packs[p].faces[i];
+            triRay.b0 = e0[i] * invDet;
+            triRay.b1 = e1[i] * invDet;
+            triRay.b2 = e2[i] * invDet;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+bool BVH::LeafNode<Triangle4>::Occluded(const TriangleRay & triRay,
+                                        const Ray3f & ray) const
+{
+    for (size_t p = 0; p < GetNumPacks(numPrimitives); ++p) {
+        RENO_STAT_ADD(Stat::kPrimitiveTests,
+                      std::min<size_t>(4, numPrimitives - 4 * p));
+        vfloat4 e0, e1, e2, det, tScaled;
+        if (MoveMask(packs[p].Intersect(triRay, ray, &e0, &e1, &e2, &det,
+                                        &tScaled)) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 TriangleMesh::TriangleMesh(std::vector<int> vertices, std::vector<Point3f> p,
-                           std::vector<Normal3f> n, std::vector<Point2f> uv)
+                           std::vector<Normal3f> n, std::vector<Point2f> uv,
+                           const std::string & splitter, bool quantize)
     : _vertices(std::move(vertices)),
     _p(std::move(p)),
     _n(std::move(n)),
@@ -461,13 +810,44 @@ TriangleMesh::TriangleMesh(std::vector<int> vertices, std::vector<Point3f> p,
     }
 
     // Build a BVH
+    auto start = std::chrono::steady_clock::now();
     _bvh = std::make_unique<BVH>();
-    ObjectSplitter splitter; 
     size_t MinLeafSize = 16;
-    BVHBuilder<Triangle, ObjectSplitter> builder(_bvh.get(), splitter,
-                                                 MinLeafSize);
+    // Quantized nodes are 4-wide
+    size_t width = quantize ? 4 : BVH::NativeWidth();
     GeometryContext gCtx;
-    builder.Build(gCtx, triPointers);
+    if (splitter == "spatial") {
+        SpatialSplitter<GeometryContext> spatialSplitter(
+                gCtx, GetObjectBounds(), numTriangles);
+        BVHBuilder<Triangle, SpatialSplitter<GeometryContext>,
+                   BVH::LeafNode<Triangle4>> builder(
+                _bvh.get(), spatialSplitter, MinLeafSize, width);
+        builder.Build(gCtx, triPointers);
+    } else {
+        if (splitter != "object") {
+            Warning("TriangleMesh: unknown splitter \"%s\"", splitter);
+        }
+        ObjectSplitter objectSplitter;
+        BVHBuilder<Triangle, ObjectSplitter,
+                   BVH::LeafNode<Triangle4>> builder(
+                _bvh.get(), objectSplitter, MinLeafSize, width);
+        builder.Build(gCtx, triPointers);
+    }
+    float sahCost = _bvh->SAHCost<Triangle4>();
+    size_t memoryUsage = _bvh->MemoryUsage<Triangle4>();
+    if (quantize) {
+        _bvh->Quantize<Triangle4>();
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+    Info("TriangleMesh: built BVH over %d triangles in %.3f ms "
+         "(%s splits, SAH cost %.2f, %.1f KiB)", numTriangles,
+         elapsed.count(), splitter, sahCost,
+         _bvh->MemoryUsage<Triangle4>() / 1024.f);
+    if (quantize) {
+        Info("TriangleMesh: quantized nodes use %.1f KiB instead of %.1f KiB",
+             _bvh->MemoryUsage<Triangle4>() / 1024.f, memoryUsage / 1024.f);
+    }
 
     // Make samplable
     std::vector<float> areas(numTriangles);
@@ -480,12 +860,25 @@ TriangleMesh::TriangleMesh(std::vector<int> vertices, std::vector<Point3f> p,
 bool TriangleMesh::Intersect(const GeometryContext & ctx, const Ray3f & ray,
                              ShadingPoint * sp) const
 {
-    _bvh->Intersect<Triangle, GeometryContext>(ctx, ray, sp);
+    // The BVH is in object space. Transforming the ray does not change its
+    // parametric distances.
+    Ray3f objRay = ctx.WorldToObject(ray);
+    TriangleRay triRay(objRay);
+    if (!_bvh->Intersect<Triangle4>(triRay, objRay, sp)) {
+        return false;
+    }
+
+    ray.tMax() = objRay.tMax();
+    _triangles[triRay.face].SetIntersection(ctx, ray, triRay.b0, triRay.b1,
+                                            triRay.b2, sp);
+    return true;
 }
 
 bool TriangleMesh::Occluded(const GeometryContext & ctx, const Ray3f & ray) const
 {
-    _bvh->Occluded<Triangle, GeometryContext>(ctx, ray);
+    Ray3f objRay = ctx.WorldToObject(ray);
+    TriangleRay triRay(objRay);
+    return _bvh->Occluded<Triangle4>(triRay, objRay);
 }
 
 void TriangleMesh::ComputeShadingInfo(const GeometryContext & ctx,
@@ -499,7 +892,7 @@ ShadingPoint TriangleMesh::Sample(const GeometryContext & ctx,
 {
     // Select a triangle
     float facePdf;
-    int face = _distrib.SampleDiscrete(sampler.Get1D(), &facePdf, nullptr);
+    int face = _distrib.SampleDiscrete(sampler.Get2D(), &facePdf, nullptr);
     assert(face < _triangles.size());
 
     // Sample the triangle
@@ -517,6 +910,27 @@ float TriangleMesh::Pdf(const GeometryContext & ctx, const ShadingPoint & sp) co
     return facePdf * trianglePdf;
 }
 
+float TriangleMesh::Area(const GeometryContext & ctx) const
+{
+    float area = 0.f;
+    for (const Triangle & triangle : _triangles) {
+        area += triangle.Area(ctx);
+    }
+    return area;
+}
+
+DirectionCone TriangleMesh::GetNormalCone(const GeometryContext & ctx) const
+{
+    DirectionCone cone;
+    for (const Triangle & triangle : _triangles) {
+        cone = Union(cone, triangle.GetNormalCone(ctx));
+        if (cone.cosTheta == -1.f) {
+            break;
+        }
+    }
+    return cone.IsEmpty() ? DirectionCone::EntireSphere() : cone;
+}
+
 Bounds3f TriangleMesh::GetObjectBounds() const
 {
     Bounds3f bounds;
@@ -543,9 +957,17 @@ Geometry * CreateGeometry(const ParameterList & params)
     std::vector<Point3f> p = params.GetPoint3fs("P");
     std::vector<Normal3f> n = params.GetNormal3fs("N");
     std::vector<Point2f> uv = params.GetPoint2fs("uv");
-    
+
+    // Either "object" or "spatial" (SBVH) splits
+    std::string defSplitter = "object";
+    std::string splitter = params.GetString("splitter", &defSplitter);
+
+    // Compress the BVH into 64 byte quantized nodes
+    bool defQuantize = false;
+    bool quantize = params.GetBool("quantize", &defQuantize);
+
     return new TriangleMesh(std::move(vertices), std::move(p),
-                            std::move(n), std::move(uv));
+                            std::move(n), std::move(uv), splitter, quantize);
 }
 
 } // namespace renoster
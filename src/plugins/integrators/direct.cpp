@@ -38,6 +38,7 @@ void DirectLighting::Integrate(IntegratorContext & ctx, const Ray3f & ray,
     if (!ctx.scene.Intersect(ray, &sp)) {
         return;
     }
+    WriteSurfaceAovs(ray, sp, accum);
 
     float pdfEmit;
     Color Le = ctx.scene.EvaluateEmission(sp, &pdfEmit);
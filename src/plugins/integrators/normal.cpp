@@ -19,6 +19,7 @@ void NormalIntegrator::Integrate(IntegratorContext & ctx, const Ray3f & ray,
     if (!ctx.scene.Intersect(ray, &sp)) {
         return;
     }
+    WriteSurfaceAovs(ray, sp, accum);
 
     accum->WriteValue(Color(std::abs(sp.ng.x()),
                             std::abs(sp.ng.y()),
@@ -24,6 +24,7 @@ void Occlusion::Integrate(IntegratorContext & ctx, const Ray3f & ray,
     if (!ctx.scene.Intersect(ray, &sp)) {
         return;
     }
+    WriteSurfaceAovs(ray, sp, accum);
 
     for (int i = 0; i < _numSamples; ++i) {
         Point2f u = ctx.sampler.Get2D();
@@ -1,4 +1,5 @@
 #include "renoster/integrator.h"
+#include "renoster/stats.h"
 
 namespace renoster {
 
@@ -42,6 +43,8 @@ void PathTracer::Integrate(IntegratorContext & ctx, const Ray3f & r,
         }
 
         if (depth == 0) {
+            WriteSurfaceAovs(ray, sp, accum);
+
             float pdfEmit;
             Color Le = ctx.scene.EvaluateEmission(sp, &pdfEmit);
             accum->AddSample(Le);
@@ -61,7 +64,13 @@ void PathTracer::Integrate(IntegratorContext & ctx, const Ray3f & r,
         // Sample BSDF
         Vector3f wi;
         float pdfBsdf;
-        throughput *= sp.bsdf->Sample(ctx.sampler, &wi, &pdfBsdf);
+        Color weight = sp.bsdf->Sample(ctx.sampler, &wi, &pdfBsdf);
+        throughput *= weight;
+
+        // The weight of a BSDF sample estimates the albedo
+        if (depth == 0) {
+            accum->WriteAov(Aov::kAlbedo, pdfBsdf == 0.f ? Color(0.f) : weight);
+        }
         if (pdfBsdf == 0.f || throughput.IsBlack()) {
             return;
         }
@@ -70,6 +79,7 @@ void PathTracer::Integrate(IntegratorContext & ctx, const Ray3f & r,
         if (throughput.ChannelMax() < _rrThreshold && depth >= _rrDepth) {
             float q = std::max(0.05f, 1.f - throughput.ChannelMax());
             if (ctx.sampler.Get1D() < q) {
+                RENO_STAT_ADD(Stat::kRussianRouletteKills, 1);
                 return;
             }
             throughput /= 1.f - q;
@@ -23,6 +23,8 @@ public:
     Color EvaluateEmission(const LightContext & ctx, const ShadingPoint & sp,
                            float * pdf) const;
 
+    bool GetBounds(const LightContext & ctx, LightBounds * bounds) const;
+
 private:
     Color _radiance;
     bool _twoSided;
@@ -121,6 +123,23 @@ Color DiffuseGeometryLight::EvaluateEmission(const LightContext &lCtx,
     return (_twoSided || Dot(sp.ng, sp.wo) > 0.f) ? _radiance : Color(0.f);
 }
 
+bool DiffuseGeometryLight::GetBounds(const LightContext & lCtx,
+                                     LightBounds * bounds) const
+{
+    GeometryContext gCtx(lCtx.WorldToLight, lCtx.LightToWorld);
+    DirectionCone normals = _geometry->GetNormalCone(gCtx);
+
+    // The light is emitted into the hemisphere around the normal
+    bounds->bounds = _geometry->GetWorldBounds(gCtx);
+    bounds->w = normals.w;
+    bounds->phi = std::max(0.f, _radiance.Luminance()) * Pi *
+                  (_twoSided ? 2.f : 1.f) * _geometry->Area(gCtx);
+    bounds->cosThetaO = normals.cosTheta;
+    bounds->cosThetaE = 0.f;
+    bounds->twoSided = _twoSided;
+    return true;
+}
+
 extern "C"
 RENO_EXPORT
 GeometryLight * CreateGeometryLight(const ParameterList & params,
@@ -2,45 +2,92 @@
 #include "renoster/paramlist.h"
 #include "renoster/rng.h"
 #include "renoster/sampler.h"
+#include "renoster/util/hash.h"
+#include "renoster/util/vuint4.h"
 
-#include <random>
+#include <cstdint>
 
 namespace renoster {
 
+namespace {
+
+/// Multiplies both 64 bit lanes of a by c, keeping the lower 64 bits
+__m128i Mul64(__m128i a, uint64_t c)
+{
+    __m128i b = _mm_set1_epi64x(static_cast<long long>(c));
+    __m128i lo = _mm_mul_epu32(a, b);
+    __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                                  _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+    return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+}
+
+/// MixBits() of both 64 bit lanes of v
+__m128i MixBits2(__m128i v)
+{
+    v = _mm_xor_si128(v, _mm_srli_epi64(v, 30));
+    v = Mul64(v, 0xbf58476d1ce4e5b9ULL);
+    v = _mm_xor_si128(v, _mm_srli_epi64(v, 27));
+    v = Mul64(v, 0x94d049bb133111ebULL);
+    v = _mm_xor_si128(v, _mm_srli_epi64(v, 31));
+    return v;
+}
+
+}  // anonymous namespace
+
+/// IndependentSampler takes uniform random numbers from a counter-based
+/// hash of the pixel, the sample index, the dimension and the seed
 class IndependentSampler : public Sampler {
 public:
     IndependentSampler(int spp, int seed);
 
-    float Get1D();
-
-    Point2f Get2D();
+    void GenerateSamples(const Point2i & pixel, int sampleIndex,
+                         int firstDimension, int numDimensions,
+                         float * samples);
 
-    std::unique_ptr<Sampler> Clone(int seed);
+    std::unique_ptr<Sampler> Clone();
 
 private:
-    RNG _rng;
+    int _seed;
 };
 
 IndependentSampler::IndependentSampler(int spp, int seed)
-    : Sampler(spp)
-{
-
-    _rng.Seed(seed);
-}
-
-float IndependentSampler::Get1D()
+    : Sampler(spp), _seed(seed)
 {
-    return _rng.UniformFloat();
 }
 
-Point2f IndependentSampler::Get2D()
+void IndependentSampler::GenerateSamples(const Point2i & pixel,
+                                         int sampleIndex,
+                                         int firstDimension,
+                                         int numDimensions, float * samples)
 {
-    return Point2f(Get1D(), Get1D());
+    // Every dimension is HashCombine(sampleHash, dimension), the lower 32
+    // bits are the first coordinate and the upper ones the second. Two
+    // dimensions are hashed at once, their 64 bit lanes make up the four
+    // coordinates in order.
+    uint64_t sampleHash = Hash(pixel.x(), pixel.y(), sampleIndex, _seed);
+    __m128i hash = _mm_set1_epi64x(static_cast<long long>(sampleHash));
+    __m128i offset = _mm_set1_epi64x(static_cast<long long>(
+            0x9e3779b97f4a7c15ULL + (sampleHash << 6) + (sampleHash >> 2)));
+    __m128i dimension = _mm_set_epi64x(firstDimension + 1, firstDimension);
+    __m128i step = _mm_set1_epi64x(2);
+    for (int i = 0; i < numDimensions; i += 2) {
+        vuint4 bits = MixBits2(
+                _mm_xor_si128(hash, _mm_add_epi64(dimension, offset)));
+        vfloat4 u = Min(ConvertToFloat(bits) * vfloat4(0x1p-32f),
+                        vfloat4(OneMinusEpsilon));
+        if (i + 1 < numDimensions) {
+            u.StoreUnaligned(samples + 2 * i);
+        } else {
+            samples[2 * i] = u[0];
+            samples[2 * i + 1] = u[1];
+        }
+        dimension = _mm_add_epi64(dimension, step);
+    }
 }
 
-std::unique_ptr<Sampler> IndependentSampler::Clone(int seed)
+std::unique_ptr<Sampler> IndependentSampler::Clone()
 {
-    return std::make_unique<IndependentSampler>(samplesPerPixel_, seed);
+    return std::make_unique<IndependentSampler>(samplesPerPixel_, _seed);
 }
 
 extern "C"
@@ -0,0 +1,147 @@
+#include "renoster/export.h"
+#include "renoster/paramlist.h"
+#include "renoster/rng.h"
+#include "renoster/sampler.h"
+#include "renoster/util/hash.h"
+#include "renoster/util/vuint4.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace renoster {
+
+namespace {
+
+// The functions below take four dimensions at once, one in every lane
+
+vuint4 ReverseBits32(vuint4 x)
+{
+    x = (x << 16) | (x >> 16);
+    x = ((x & vuint4(0x00ff00ff)) << 8) | ((x >> 8) & vuint4(0x00ff00ff));
+    x = ((x & vuint4(0x0f0f0f0f)) << 4) | ((x >> 4) & vuint4(0x0f0f0f0f));
+    x = ((x & vuint4(0x33333333)) << 2) | ((x >> 2) & vuint4(0x33333333));
+    x = ((x & vuint4(0x55555555)) << 1) | ((x >> 1) & vuint4(0x55555555));
+    return x;
+}
+
+/// Permutes the bits of x so that every bit only depends on the bits
+/// below it (Laine and Karras 2011)
+vuint4 LaineKarrasPermutation(vuint4 x, const vuint4 & seed)
+{
+    x += seed;
+    x ^= x * vuint4(0x6c50b47cu);
+    x ^= x * vuint4(0xb82f1e52u);
+    x ^= x * vuint4(0xc7afe638u);
+    x ^= x * vuint4(0x8d22f6e6u);
+    return x;
+}
+
+/// Owen scrambles a fixed point number in [0, 1): every bit is flipped
+/// depending on the bits above it
+vuint4 OwenScramble(const vuint4 & x, const vuint4 & seed)
+{
+    return ReverseBits32(LaineKarrasPermutation(ReverseBits32(x), seed));
+}
+
+/// Second dimension of the Sobol sequence, of the bit reversed index. Its
+/// generator matrix is the Pascal matrix modulo 2, which splits into the
+/// same 2x2 block at every bit level.
+vuint4 SobolDimension1Reversed(vuint4 x)
+{
+    x ^= x << 16;
+    x ^= (x << 8) & vuint4(0xff00ff00);
+    x ^= (x << 4) & vuint4(0xf0f0f0f0);
+    x ^= (x << 2) & vuint4(0xcccccccc);
+    x ^= (x << 1) & vuint4(0xaaaaaaaa);
+    return x;
+}
+
+vfloat4 ToFloat(const vuint4 & x)
+{
+    return Min(ConvertToFloat(x) * vfloat4(0x1p-32f),
+               vfloat4(OneMinusEpsilon));
+}
+
+}  // anonymous namespace
+
+/// SobolSampler takes the samples of a pixel from the first two dimensions
+/// of the Sobol sequence, Owen scrambled (Burley 2020). Every dimension
+/// shuffles the samples and scrambles the points with its own seed. Get1D()
+/// takes the first coordinate of a point. The seeds are hashed from the
+/// pixel and the number of dimensions taken before in the sample, so the
+/// samples do not depend on the tiles or the threads rendering them.
+class SobolSampler : public Sampler {
+public:
+    SobolSampler(int spp, int seed);
+
+    void GenerateSamples(const Point2i & pixel, int sampleIndex,
+                         int firstDimension, int numDimensions,
+                         float * samples);
+
+    std::unique_ptr<Sampler> Clone();
+
+private:
+    int _seed;
+};
+
+SobolSampler::SobolSampler(int spp, int seed)
+    : Sampler(spp), _seed(seed)
+{
+}
+
+void SobolSampler::GenerateSamples(const Point2i & pixel, int sampleIndex,
+                                   int firstDimension, int numDimensions,
+                                   float * samples)
+{
+    uint64_t pixelHash = Hash(pixel.x(), pixel.y(), _seed);
+    vuint4 reversedSample = ReverseBits32(vuint4(sampleIndex));
+
+    // The seeds are hashed with 64 bits, the scrambling of four dimensions
+    // is done at once
+    for (int i = 0; i < numDimensions; i += 4) {
+        vuint4 seed, xSeed, ySeed;
+        for (int j = 0; j < 4; ++j) {
+            seed[j] = static_cast<uint32_t>(
+                    HashCombine(pixelHash, firstDimension + i + j));
+            uint64_t pointSeed = MixBits(seed[j]);
+            xSeed[j] = static_cast<uint32_t>(pointSeed);
+            ySeed[j] = static_cast<uint32_t>(pointSeed >> 32);
+        }
+
+        // Shuffle the samples. The first dimension of the Sobol sequence
+        // is the bit reversed index, which the scrambling of the point
+        // reverses again.
+        vuint4 reversedIndex = LaineKarrasPermutation(reversedSample, seed);
+        vfloat4 x = ToFloat(ReverseBits32(LaineKarrasPermutation(
+                ReverseBits32(reversedIndex), xSeed)));
+        vfloat4 y = ToFloat(OwenScramble(
+                SobolDimension1Reversed(reversedIndex), ySeed));
+
+        // Interleave the coordinates of the points
+        float points[8];
+        vfloat4(_mm_unpacklo_ps(x, y)).StoreUnaligned(points);
+        vfloat4(_mm_unpackhi_ps(x, y)).StoreUnaligned(points + 4);
+        std::copy(points, points + 2 * std::min(4, numDimensions - i),
+                  samples + 2 * i);
+    }
+}
+
+std::unique_ptr<Sampler> SobolSampler::Clone()
+{
+    return std::make_unique<SobolSampler>(samplesPerPixel_, _seed);
+}
+
+extern "C"
+RENO_EXPORT
+Sampler * CreateSampler(ParameterList & params)
+{
+    int defaultSpp = 1;
+    int spp = params.GetInt("spp", &defaultSpp);
+
+    int defaultSeed = 0;
+    int seed = params.GetInt("seed", &defaultSeed);
+
+    return new SobolSampler(spp, seed);
+}
+
+}  // namespace renoster
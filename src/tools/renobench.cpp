@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "renoster/log.h"
+#include "renoster/paramlist.h"
+#include "renoster/plugin.h"
+#include "renoster/reno.h"
+#include "renoster/renoparser.h"
+
+namespace po = boost::program_options;
+
+using namespace renoster;
+
+double RenderScene(const std::string & filename, int numThreads)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    RenoBegin();
+    // The thread count overrides the options of the scene file
+    ParameterList params;
+    params.SetInts("nthreads", {numThreads});
+    RenoOptionOverride("render", params);
+    ParseRenoFile(filename);
+    RenoEnd();
+
+    std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char * argv[])
+{
+    int maxThreads = 0;
+    int repeats = 1;
+    std::string filename;
+
+    po::options_description generic("Generic options");
+    generic.add_options()
+        ("version,v", "print version string")
+        ("help,h", "produce help message");
+
+    po::options_description benchmark("Benchmark options");
+    benchmark.add_options()
+        ("maxthreads", po::value<int>(&maxThreads),
+         "largest number of threads to measure (0 uses all hardware threads)")
+        ("repeats", po::value<int>(&repeats),
+         "number of renders per thread count, the fastest is reported");
+
+    po::options_description hidden("Hidden options");
+    hidden.add_options()
+        ("filename", po::value<std::string>(&filename));
+
+    po::positional_options_description positionals;
+    positionals.add("filename", 1);
+
+    po::options_description options;
+    options.add(generic);
+    options.add(benchmark);
+    options.add(hidden);
+
+    po::variables_map vm;
+
+    try
+    {
+        po::command_line_parser parser(argc, argv);
+        parser.options(options);
+        parser.positional(positionals);
+        po::store(parser.run(), vm);
+    }
+    catch (po::error & e)
+    {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
+    po::notify(vm);
+
+    if (vm.count("help") || filename.empty())
+    {
+        po::options_description cmdlineOptions;
+        cmdlineOptions.add(generic);
+        cmdlineOptions.add(benchmark);
+        std::cout << "Usage: renobench [options] scene.reno" << std::endl;
+        std::cout << cmdlineOptions << std::endl;
+        return 1;
+    }
+
+    if (maxThreads <= 0) {
+        maxThreads = std::max(
+                1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    repeats = std::max(1, repeats);
+
+    // Measure powers of two and the maximum itself
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2) {
+        threadCounts.push_back(n);
+    }
+    threadCounts.push_back(maxThreads);
+
+    SetPluginSearchPath(".");
+
+    std::vector<double> times;
+    for (int numThreads : threadCounts) {
+        double best = 0.f;
+        for (int i = 0; i < repeats; ++i) {
+            double time = RenderScene(filename, numThreads);
+            best = i == 0 ? time : std::min(best, time);
+        }
+        times.push_back(best);
+    }
+
+    std::cout << "threads      time   speedup  efficiency" << std::endl;
+    for (size_t i = 0; i < threadCounts.size(); ++i) {
+        double speedup = times[0] / times[i];
+        double efficiency = speedup / threadCounts[i];
+        std::cout << Format("%7d %8.3fs %8.2fx %10.1f%%", threadCounts[i],
+                            times[i], speedup, 100.0 * efficiency)
+                  << std::endl;
+    }
+
+    return 0;
+}
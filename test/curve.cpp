@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <utility>
+
+#include "renoster/util/curve.h"
+
+using namespace renoster;
+
+TEST(CurveTest, MortonRoundTrip)
+{
+    for (uint32_t y = 0; y < 64; ++y) {
+        for (uint32_t x = 0; x < 64; ++x) {
+            uint32_t dx, dy;
+            DecodeMorton2(EncodeMorton2(x, y), &dx, &dy);
+            EXPECT_EQ(x, dx);
+            EXPECT_EQ(y, dy);
+        }
+    }
+}
+
+TEST(CurveTest, HilbertVisitsNeighbours)
+{
+    const uint32_t n = 16;
+    std::set<std::pair<uint32_t, uint32_t>> visited;
+    uint32_t px, py;
+    DecodeHilbert2(n, 0, &px, &py);
+    visited.emplace(px, py);
+    for (uint32_t d = 1; d < n * n; ++d) {
+        uint32_t x, y;
+        DecodeHilbert2(n, d, &x, &y);
+        EXPECT_LT(x, n);
+        EXPECT_LT(y, n);
+        EXPECT_EQ(1u, (x > px ? x - px : px - x) + (y > py ? y - py : py - y));
+        visited.emplace(x, y);
+        px = x;
+        py = y;
+    }
+    EXPECT_EQ(n * n, visited.size());
+}
+
+TEST(CurveTest, MortonVisitsRectanglesOnce)
+{
+    const std::pair<uint32_t, uint32_t> sizes[] = {
+        {16, 16}, {64, 3}, {3, 64}, {33, 20}, {1, 1}, {7, 0}};
+    for (const auto & size : sizes) {
+        std::set<std::pair<uint32_t, uint32_t>> visited;
+        uint32_t numVisits = 0;
+        VisitMorton2(5, 9, size.first, size.second,
+                     [&](uint32_t x, uint32_t y) {
+            EXPECT_GE(x, 5u);
+            EXPECT_LT(x, 5u + size.first);
+            EXPECT_GE(y, 9u);
+            EXPECT_LT(y, 9u + size.second);
+            visited.emplace(x, y);
+            ++numVisits;
+        });
+        EXPECT_EQ(size.first * size.second, numVisits);
+        EXPECT_EQ(size.first * size.second, visited.size());
+    }
+
+    // Square tiles keep the plain Morton order
+    uint32_t code = 0;
+    VisitMorton2(0, 0, 8, 8, [&code](uint32_t x, uint32_t y) {
+        EXPECT_EQ(code++, EncodeMorton2(x, y));
+    });
+}
@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "renoster/filtertable.h"
+#include "renoster/rng.h"
+
+using namespace renoster;
+
+namespace {
+
+/// Cone that falls off to zero at the radius
+class ConeFilter : public PixelFilter {
+public:
+    explicit ConeFilter(const Vector2f & radius) : _radius(radius) {}
+
+    float Evaluate(const Point2f & p) const {
+        return std::max(0.f, 1.f - std::abs(p.x()) / _radius.x()) *
+               std::max(0.f, 1.f - std::abs(p.y()) / _radius.y());
+    }
+
+    Vector2f GetRadius() const { return _radius; }
+
+private:
+    Vector2f _radius;
+};
+
+}  // anonymous namespace
+
+TEST(FilterTableTest, EvaluatesWideFilters)
+{
+    ConeFilter filter(Vector2f(2.5f, 1.5f));
+    FilterTable table(&filter, 64);
+    RNG rng;
+    for (int i = 0; i < 1000; ++i) {
+        Point2f p((2.f * rng.UniformFloat() - 1.f) * 2.5f,
+                  (2.f * rng.UniformFloat() - 1.f) * 1.5f);
+        ASSERT_NEAR(filter.Evaluate(p), table.Evaluate(p), 0.05f);
+    }
+}
+
+TEST(FilterTableTest, FootprintMatchesEvaluate)
+{
+    ConeFilter filter(Vector2f(3.f, 2.f));
+    FilterTable table(&filter, 16);
+    RNG rng;
+    for (int width = 1; width <= 7; ++width) {
+        int height = 5;
+        Point2f p(-3.f * rng.UniformFloat(), -2.f * rng.UniformFloat());
+        std::vector<float> weights(width * height);
+        table.EvaluateFootprint(p, width, height, weights.data());
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                ASSERT_EQ(table.Evaluate(Point2f(p.x() + x, p.y() + y)),
+                          weights[y * width + x]);
+            }
+        }
+    }
+}
@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+#include "renoster/lightbvh.h"
+#include "renoster/rng.h"
+
+using namespace renoster;
+
+namespace {
+
+/// Point light facing down, or a light without bounds if phi is negative
+class TestLight : public Primitive {
+public:
+    TestLight(const Point3f & p, float phi) : _p(p), _phi(phi) {}
+
+    bool GetLightBounds(const PrimitiveContext & ctx,
+                        LightBounds * bounds) const override
+    {
+        if (_phi < 0.f) {
+            return false;
+        }
+        bounds->bounds = Bounds3f(_p, _p);
+        bounds->w = Vector3f(0.f, 0.f, -1.f);
+        bounds->phi = _phi;
+        bounds->cosThetaO = 1.f;
+        bounds->cosThetaE = 0.f;
+        return true;
+    }
+
+private:
+    Point3f _p;
+    float _phi;
+};
+
+}  // anonymous namespace
+
+TEST(LightBVHTest, SampleMatchesPmf)
+{
+    std::vector<std::unique_ptr<Primitive>> lights;
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Point3f p(4.f * rng.UniformFloat() - 2.f,
+                  4.f * rng.UniformFloat() - 2.f, 1.f);
+        float phi = i == 10 ? 0.f : i == 20 ? -1.f : rng.UniformFloat();
+        lights.emplace_back(new TestLight(p, phi));
+    }
+    std::vector<Primitive *> lightPtrs;
+    for (const auto & light : lights) {
+        lightPtrs.push_back(light.get());
+    }
+    LightBVH bvh(lightPtrs);
+
+    ShadingPoint ref;
+    ref.p = Point3f(0.5f, -0.25f, 0.f);
+    ref.ns = Normal3f(0.f, 0.f, 1.f);
+
+    float sum = 0.f;
+    for (size_t i = 0; i < lights.size(); ++i) {
+        sum += bvh.Pmf(ref, static_cast<int>(i));
+    }
+    EXPECT_NEAR(1.f, sum, 1e-4f);
+    EXPECT_EQ(0.f, bvh.Pmf(ref, 10));
+    EXPECT_FLOAT_EQ(0.5f, bvh.Pmf(ref, 20));
+
+    for (int i = 0; i < 1000; ++i) {
+        float pmf;
+        int lightId = bvh.Sample(ref, rng.UniformFloat(), &pmf);
+        ASSERT_GE(lightId, 0);
+        ASSERT_NE(10, lightId);
+        ASSERT_GT(pmf, 0.f);
+        ASSERT_NEAR(bvh.Pmf(ref, lightId), pmf, 1e-5f * pmf);
+    }
+
+    // Lights that face away from the point are never picked
+    ref.p = Point3f(0.f, 0.f, 2.f);
+    EXPECT_EQ(0.f, bvh.Pmf(ref, 0));
+    float pmf;
+    EXPECT_EQ(20, bvh.Sample(ref, 0.75f, &pmf));
+    EXPECT_FLOAT_EQ(0.5f, pmf);
+}
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+
+#include "renoster/parallel.h"
+
+using namespace renoster;
+
+TEST(ParallelTest, ParallelForCoversRange)
+{
+    ParallelInit(4);
+
+    std::vector<std::atomic<int>> counts(1000);
+    ParallelFor(0, 1000, 7, [&](int64_t begin, int64_t end) {
+        EXPECT_LE(end - begin, 7);
+        for (int64_t i = begin; i < end; ++i) {
+            counts[i]++;
+        }
+    });
+
+    for (std::atomic<int> & count : counts) {
+        EXPECT_EQ(1, count.load());
+    }
+
+    ParallelCleanup();
+}
+
+TEST(ParallelTest, NestedTaskGroups)
+{
+    ParallelInit(4);
+
+    std::atomic<int> sum(0);
+    TaskGroup outer;
+    for (int i = 0; i < 16; ++i) {
+        outer.Spawn([&sum]() {
+            TaskGroup inner;
+            for (int j = 0; j < 16; ++j) {
+                inner.Spawn([&sum, j]() { sum += j; });
+            }
+            inner.Wait();
+        });
+    }
+    outer.Wait();
+
+    EXPECT_EQ(16 * 120, sum.load());
+
+    ParallelCleanup();
+}
+
+TEST(ParallelTest, SingleThreadRunsInline)
+{
+    ParallelInit(1);
+    EXPECT_EQ(1, NumThreads());
+    EXPECT_EQ(0, ThreadIndex());
+
+    int sum = 0;
+    ParallelFor(0, 10, 3, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            sum += i;
+        }
+    });
+    EXPECT_EQ(45, sum);
+
+    ParallelCleanup();
+}
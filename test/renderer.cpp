@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "renoster/display.h"
+#include "renoster/parallel.h"
+#include "renoster/renderer.h"
+
+using namespace renoster;
+
+namespace {
+
+class ConstantSampler : public Sampler {
+public:
+    explicit ConstantSampler(int spp) : Sampler(spp) {}
+
+    void GenerateSamples(const Point2i & pixel, int sampleIndex,
+                         int firstDimension, int numDimensions,
+                         float * samples)
+    {
+        for (int i = 0; i < 2 * numDimensions; ++i) {
+            samples[i] = 0.5f;
+        }
+    }
+
+    std::unique_ptr<Sampler> Clone()
+    {
+        return std::make_unique<ConstantSampler>(*this);
+    }
+};
+
+class TestCamera : public Camera {
+public:
+    TestCamera() : Camera(IdentityTransform(), IdentityTransform()) {}
+
+    void RenderBegin(CameraEnvironment & env) {}
+
+    void RenderEnd() {}
+
+    float GenerateRay(Sampler & sampler, const Point2f & pScreen, float time,
+                      Ray3f * ray) const
+    {
+        *ray = Ray3f(Point3f(pScreen.x(), pScreen.y(), 0.f),
+                     Vector3f(0.f, 0.f, 1.f), 0.f, Infinity, time);
+        return 1.f;
+    }
+};
+
+class ConstantIntegrator : public Integrator {
+public:
+    void Integrate(IntegratorContext & ctx, const Ray3f & ray,
+                   FilmAccumulator * accum) const
+    {
+        accum->WriteValue(Color(1.f));
+    }
+};
+
+class TestFilter : public PixelFilter {
+public:
+    float Evaluate(const Point2f & p) const { return 1.f; }
+
+    Vector2f GetRadius() const { return Vector2f(0.5f, 0.5f); }
+};
+
+class NullDisplay : public Display {
+public:
+    bool Open(const Vector2i & resolution,
+              const std::vector<std::string> & channelNames)
+    {
+        return true;
+    }
+
+    bool WriteData(float * pixels) { return true; }
+
+    bool Close() { return true; }
+
+    std::string GetError() { return std::string(); }
+};
+
+}  // anonymous namespace
+
+TEST(RendererTest, CheckpointsSinglePassRenders)
+{
+    std::string filename = ::testing::TempDir() + "renderer_checkpoint.bin";
+    std::remove(filename.c_str());
+
+    ParallelInit(1);
+    {
+        ParameterList params;
+        params.SetInts("xresolution", {8});
+        params.SetInts("yresolution", {8});
+        std::unique_ptr<Film> film = CreateFilm(params);
+        TestFilter filter;
+        NullDisplay display;
+        TestCamera camera;
+        ConstantIntegrator integrator;
+        ConstantSampler sampler(1);
+
+        // Without pass samples or a time limit there is a single pass
+        RenderSettings settings;
+        settings.checkpointFilename = filename;
+        film->RenderBegin(&filter, &display);
+        Renderer renderer(&camera, film.get(), &integrator, &sampler,
+                          settings);
+        renderer.Render(Scene());
+        film->RenderEnd();
+
+        CheckpointProgress progress;
+        progress.samplesPerPixel = 1;
+        EXPECT_TRUE(film->ReadCheckpoint(filename, &progress));
+        EXPECT_EQ(1, progress.numSamples);
+        EXPECT_EQ(1, progress.numPasses);
+    }
+    ParallelCleanup();
+
+    EXPECT_TRUE(std::ifstream(filename).good());
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <vector>
+
+#include "renoster/rng.h"
+#include "renoster/sampling.h"
+
+using namespace renoster;
+
+namespace {
+
+/// Samples distrib and compares the frequencies of the indices to func
+void CheckDistribution(const std::vector<float> & func,
+                       int samplesPerValue = 200)
+{
+    Distribution1D distrib(func);
+
+    float sum = 0.f;
+    for (float f : func) {
+        sum += f;
+    }
+    EXPECT_NEAR(sum, distrib.Integral(), 1e-3f * sum);
+
+    int numSamples = samplesPerValue * static_cast<int>(func.size());
+    std::vector<int> counts(func.size(), 0);
+    RNG rng;
+    for (int i = 0; i < numSamples; ++i) {
+        float pdf, uRemapped;
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        int index = distrib.SampleDiscrete(u, &pdf, &uRemapped);
+        ASSERT_GE(index, 0);
+        ASSERT_LT(index, static_cast<int>(func.size()));
+        ASSERT_GT(func[index], 0.f);
+        ASSERT_NEAR(func[index] / sum, pdf, 1e-6f);
+        ASSERT_FLOAT_EQ(pdf, distrib.PdfDiscrete(index));
+        ASSERT_GE(uRemapped, 0.f);
+        ASSERT_LT(uRemapped, 1.f);
+        ++counts[index];
+    }
+
+    // Large distributions have values outside five deviations by chance,
+    // they are checked with the chi-square of all counts instead. A bias of
+    // the alias choice shows on the values below the average together.
+    bool checkEachValue = func.size() <= 4096;
+    double chiSquare = 0.0;
+    int numValues = 0;
+    double expectedBelow = 0.0;
+    double countBelow = 0.0;
+    for (size_t i = 0; i < func.size(); ++i) {
+        float expected = numSamples * func[i] / sum;
+        if (checkEachValue) {
+            EXPECT_NEAR(expected, counts[i], 5.f * std::sqrt(expected) + 1.f);
+        }
+        if (expected > 0.f) {
+            float d = counts[i] - expected;
+            chiSquare += d * d / expected;
+            ++numValues;
+        }
+        if (func[i] * func.size() < sum) {
+            expectedBelow += expected;
+            countBelow += counts[i];
+        }
+    }
+    EXPECT_NEAR(expectedBelow, countBelow,
+                5.0 * std::sqrt(expectedBelow) + 1.0);
+    EXPECT_NEAR(numValues, chiSquare, 5.0 * std::sqrt(2.0 * numValues));
+}
+
+}  // anonymous namespace
+
+TEST(Distribution1DTest, SamplesSmallDistributions)
+{
+    CheckDistribution({1.f, 0.f, 3.f, 0.5f, 2.f, 0.f, 0.25f});
+}
+
+TEST(Distribution1DTest, SamplesAliasTables)
+{
+    RNG rng;
+    for (size_t n : {4 * Distribution1D::MinAliasTableSize, size_t(1) << 17}) {
+        // At 2^17 values, u * n leaves only 7 fraction bits of a float
+        std::vector<float> func(n);
+        for (float & f : func) {
+            float u = rng.UniformFloat();
+            f = u < 0.2f ? 0.f : u < 0.6f ? 0.01f : u * u * u;
+        }
+        CheckDistribution(func, n > 4096 ? 100 : 200);
+    }
+}
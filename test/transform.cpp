@@ -0,0 +1,28 @@
+#include "gtest/gtest.h"
+
+#include "renoster/rng.h"
+#include "renoster/sampling.h"
+#include "renoster/transform.h"
+
+using namespace renoster;
+
+TEST(TransformTest, RotateInverse)
+{
+    RNG rng;
+    for (int i = 0; i < 100; ++i) {
+        Point2f u(rng.UniformFloat(), rng.UniformFloat());
+        Vector3f axis = UniformSampleSphere(u);
+        Transform T = Rotate(360.f * rng.UniformFloat(), axis);
+        Transform TInv = Inverse(T);
+
+        Point3f p(rng.UniformFloat(), rng.UniformFloat(), rng.UniformFloat());
+        Point3f q = TInv(T(p));
+        ASSERT_NEAR(p.x(), q.x(), 1e-4f);
+        ASSERT_NEAR(p.y(), q.y(), 1e-4f);
+        ASSERT_NEAR(p.z(), q.z(), 1e-4f);
+
+        // The axis is left in place
+        Vector3f a = T(axis);
+        ASSERT_NEAR(Dot(a, axis), 1.f, 1e-4f);
+    }
+}